@@ -0,0 +1,163 @@
+/*
+ * E-Lib
+ * Copyright (C) 2019 EnAccess
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+/*
+ * Feeds recorded modem transcripts through the AT reply parser and
+ * compares it with the strncmp()/sscanf() chains it replaced.
+ */
+
+#include "benchmark.h"
+#include "cicada/commdevices/atparser.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace Cicada;
+
+// Set by the build to the source directory of the transcripts
+#ifndef BENCHMARK_TRANSCRIPT_DIR
+#define BENCHMARK_TRANSCRIPT_DIR "benchmarks/transcripts"
+#endif
+
+static const uint64_t ITERATIONS = 20000;
+
+static const char* const transcripts[] = { "sim7600", "sim800" };
+
+static bool loadTranscript(const char* name, std::vector<std::string>& lines)
+{
+    std::string fileName = std::string(BENCHMARK_TRANSCRIPT_DIR) + "/" + name + ".log";
+    FILE* file = fopen(fileName.c_str(), "r");
+    if (!file)
+        return false;
+
+    char line[128];
+    while (fgets(line, sizeof(line), file)) {
+        // The modem terminates lines with \r\n
+        Size length = strcspn(line, "\r\n");
+        line[length] = '\0';
+        lines.push_back(std::string(line) + "\r\n");
+    }
+
+    fclose(file);
+    return true;
+}
+
+// The matching previously done in the drivers, in the same order
+static uint32_t parseWithStrncmp(const char* line)
+{
+    int value;
+    unsigned int a, b;
+
+    if (strncmp(line, "ERROR", 5) == 0)
+        return 1;
+    if (strncmp(line, "+CME ERROR", 10) == 0)
+        return 2;
+    if (strncmp(line, "+PDP: DEACT", 11) == 0)
+        return 3;
+    if (strncmp(line, "+NETOPEN: 1", 11) == 0)
+        return 4;
+    if (strncmp(line, "+CIPOPEN: 0,", 12) == 0)
+        return 5;
+    if (strncmp(line, "+CDNSGIP: 1", 11) == 0)
+        return 6;
+    if (strncmp(line, "+CDNSGIP: 0", 11) == 0)
+        return 7;
+    if (strncmp(line, "+CIPRXGET: 4,0,", 15) == 0) {
+        sscanf(line + 15, "%d", &value);
+        return value;
+    }
+    if (strncmp(line, "+CIPRXGET: 2,0,", 15) == 0) {
+        sscanf(line + 15, "%u,%u", &a, &b);
+        return a + b;
+    }
+    if (strncmp(line, "+CSQ: ", 6) == 0) {
+        sscanf(line + 6, "%u", &a);
+        return a;
+    }
+    if (strncmp(line, "+CIPRXGET: 1,0", 14) == 0)
+        return 8;
+    if (strncmp(line, "+IPCLOSE: 0,", 12) == 0)
+        return 9;
+    if (strncmp(line, "0, CLOSED", 9) == 0)
+        return 10;
+    if (strncmp(line, "0, CONNECT FAIL", 15) == 0)
+        return 11;
+    return 0;
+}
+
+static uint32_t parseWithTable(const char* line)
+{
+    Size prefixLength;
+    AtReply reply = AtParser::classify(line, prefixLength);
+    AtTokenizer tokenizer(line + prefixLength);
+    uint32_t link, a, b;
+
+    switch (reply) {
+    case atCiprxgetLength:
+        tokenizer.readUint(link);
+        tokenizer.readUint(a);
+        return a;
+
+    case atCiprxgetRead:
+        tokenizer.readUint(link);
+        tokenizer.readUint(a);
+        tokenizer.readUint(b);
+        return a + b;
+
+    case atCsq:
+        tokenizer.readUint(a);
+        return a;
+
+    default:
+        return reply;
+    }
+}
+
+void runAtParserBenchmarks(BenchmarkReport& report)
+{
+    for (const char* transcript : transcripts) {
+        std::vector<std::string> lines;
+        if (!loadTranscript(transcript, lines) || lines.empty()) {
+            fprintf(stderr, "Can't read transcript %s\n", transcript);
+            continue;
+        }
+
+        // One op parses the whole transcript. The time of the first result
+        // is copied, as adding the next one may move it.
+        std::string name = std::string("atparser_strncmp_") + transcript;
+        BenchmarkReport::Result& chain = report.measure(name.c_str(), ITERATIONS, [&]() {
+            for (const std::string& line : lines)
+                benchmarkSink = benchmarkSink + parseWithStrncmp(line.c_str());
+        });
+        chain.metric("lines_per_op", lines.size());
+        double strncmpNs = chain.nsPerOp;
+
+        name = std::string("atparser_table_") + transcript;
+        BenchmarkReport::Result& table = report.measure(name.c_str(), ITERATIONS, [&]() {
+            for (const std::string& line : lines)
+                benchmarkSink = benchmarkSink + parseWithTable(line.c_str());
+        });
+        table.metric("lines_per_op", lines.size()).metric("speedup", strncmpNs / table.nsPerOp);
+    }
+}
@@ -0,0 +1,119 @@
+/*
+ * E-Lib
+ * Copyright (C) 2019 EnAccess
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+/*
+ * Minimal harness for the host benchmarks. Results are collected in a
+ * report and printed as JSON, one object per benchmark.
+ */
+
+#ifndef EBENCHMARK_H
+#define EBENCHMARK_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+class BenchmarkReport
+{
+  public:
+    struct Metric
+    {
+        std::string name;
+        double value;
+    };
+
+    struct Result
+    {
+        std::string name;
+        uint64_t iterations;
+        double nsPerOp;
+        std::vector<Metric> metrics;
+
+        // Adds a benchmark specific value to the result
+        Result& metric(const char* metricName, double value)
+        {
+            Metric m = { metricName, value };
+            metrics.push_back(m);
+            return *this;
+        }
+    };
+
+    // Runs op iterations times and records the wall time per call
+    template <typename Op> Result& measure(const char* name, uint64_t iterations, Op op)
+    {
+        // Warm up caches and branch predictors first
+        for (uint64_t i = 0; i < iterations / 10; i++)
+            op();
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < iterations; i++)
+            op();
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+        double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        return add(name, iterations, ns / iterations);
+    }
+
+    Result& add(const char* name, uint64_t iterations, double nsPerOp)
+    {
+        Result result;
+        result.name = name;
+        result.iterations = iterations;
+        result.nsPerOp = nsPerOp;
+        _results.push_back(result);
+        return _results.back();
+    }
+
+    void print(FILE* file) const
+    {
+        fprintf(file, "{\n  \"benchmarks\": [");
+        for (size_t i = 0; i < _results.size(); i++) {
+            const Result& result = _results[i];
+            fprintf(file, "%s\n    { \"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.2f",
+                i ? "," : "", result.name.c_str(), (unsigned long long)result.iterations,
+                result.nsPerOp);
+            for (size_t j = 0; j < result.metrics.size(); j++) {
+                fprintf(file, ", \"%s\": %.2f", result.metrics[j].name.c_str(),
+                    result.metrics[j].value);
+            }
+            fprintf(file, " }");
+        }
+        fprintf(file, "\n  ]\n}\n");
+    }
+
+  private:
+    std::vector<Result> _results;
+};
+
+// Keeps the compiler from optimizing away benchmarked results
+extern volatile uint32_t benchmarkSink;
+
+void runAtParserBenchmarks(BenchmarkReport& report);
+void runBufferBenchmarks(BenchmarkReport& report);
+void runSchedulerBenchmarks(BenchmarkReport& report);
+void runMqttBenchmarks(BenchmarkReport& report);
+
+#endif
@@ -0,0 +1,135 @@
+/*
+ * E-Lib
+ * Copyright (C) 2019 EnAccess
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+/*
+ * Microbenchmarks for the ring buffers and line reading of the serial
+ * driver, which every byte from and to the modem passes through.
+ */
+
+#include "benchmark.h"
+#include "cicada/bufferedserial.h"
+#include "cicada/circularbuffer.h"
+#include "cicada/linecircularbuffer.h"
+#include <cstring>
+
+using namespace Cicada;
+
+static const uint64_t ITERATIONS = 2000000;
+
+static const char transcript[] = "+CIPRXGET: 1,0\r\n"
+                                 "+CIPRXGET: 4,0,512\r\n"
+                                 "OK\r\n"
+                                 "+CIPRXGET: 2,0,512,0\r\n"
+                                 "+CSQ: 17,99\r\n"
+                                 "OK\r\n";
+
+// Serial device which delivers the transcript over and over again
+class TranscriptSerial : public BufferedSerial
+{
+  public:
+    TranscriptSerial() : _pos(0) {}
+
+    bool open()
+    {
+        return true;
+    }
+    bool isOpen()
+    {
+        return true;
+    }
+    bool setSerialConfig(uint32_t baudRate, uint8_t dataBits)
+    {
+        (void)baudRate;
+        (void)dataBits;
+        return true;
+    }
+    void close() {}
+    const char* portName() const
+    {
+        return "transcript";
+    }
+
+  protected:
+    Size rawRead(uint8_t* data, Size maxSize)
+    {
+        Size size = sizeof(transcript) - 1 - _pos;
+        if (size > maxSize)
+            size = maxSize;
+        memcpy(data, transcript + _pos, size);
+        _pos = (_pos + size) % (sizeof(transcript) - 1);
+        return size;
+    }
+
+    Size rawWrite(const uint8_t* data, Size size)
+    {
+        (void)data;
+        return size;
+    }
+
+    void startTransmit() {}
+
+  private:
+    Size _pos;
+};
+
+void runBufferBenchmarks(BenchmarkReport& report)
+{
+    CircularBuffer<uint8_t, 1024> buffer;
+    uint8_t block[64] = {};
+
+    report.measure("circularbuffer_push_pull_byte", ITERATIONS, [&]() {
+        buffer.push((uint8_t)benchmarkSink);
+        benchmarkSink = benchmarkSink + buffer.pull();
+    });
+
+    report
+        .measure("circularbuffer_push_pull_block", ITERATIONS / 4,
+            [&]() {
+                buffer.push(block, sizeof(block));
+                benchmarkSink = benchmarkSink + buffer.pull(block, sizeof(block));
+            })
+        .metric("block_size", sizeof(block));
+
+    LineCircularBuffer<1024> lineBuffer;
+    char line[64];
+    const Size lineCount = 6;
+
+    report
+        .measure("linecircularbuffer_push_readline", ITERATIONS / 8,
+            [&]() {
+                lineBuffer.push(transcript, sizeof(transcript) - 1);
+                for (Size i = 0; i < lineCount; i++)
+                    benchmarkSink = benchmarkSink + lineBuffer.readLine(line, sizeof(line));
+            })
+        .metric("lines_per_op", lineCount);
+
+    TranscriptSerial serial;
+    uint8_t serialLine[64];
+
+    report.measure("bufferedserial_readline", ITERATIONS / 4, [&]() {
+        if (!serial.canReadLine())
+            serial.transferToAndFromBuffer();
+        benchmarkSink = benchmarkSink + serial.readLine(serialLine, sizeof(serialLine));
+    });
+}
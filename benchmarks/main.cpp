@@ -0,0 +1,57 @@
+/*
+ * E-Lib
+ * Copyright (C) 2019 EnAccess
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+/*
+ * Benchmark suite for the AT parser, buffers, scheduler and the modem
+ * drivers. Prints the results as JSON, to the file given as argument or
+ * to stdout.
+ *
+ * Usage: benchmarks [<output.json>]
+ */
+
+#include "benchmark.h"
+
+volatile uint32_t benchmarkSink;
+
+int main(int argc, char* argv[])
+{
+    BenchmarkReport report;
+
+    runAtParserBenchmarks(report);
+    runBufferBenchmarks(report);
+    runSchedulerBenchmarks(report);
+    runMqttBenchmarks(report);
+
+    FILE* file = argc > 1 ? fopen(argv[1], "w") : stdout;
+    if (!file) {
+        fprintf(stderr, "Can't write %s\n", argv[1]);
+        return 1;
+    }
+
+    report.print(file);
+    if (file != stdout)
+        fclose(file);
+
+    return 0;
+}
@@ -0,0 +1,220 @@
+/*
+ * E-Lib
+ * Copyright (C) 2019 EnAccess
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+/*
+ * End-to-end MQTT publish/subscribe loop: the Paho client on top of
+ * BlockingCommDevice and the SIM7x00 driver, against the modem emulator
+ * with a broker stub as peer. Time is simulated, one ms passes with every
+ * round through the scheduler, so the results are deterministic.
+ */
+
+#include "benchmark.h"
+#include "cicada/commdevices/blockingcommdev.h"
+#include "cicada/commdevices/sim7x00.h"
+#include "cicada/mqttcountdown.h"
+#include "cicada/platform/linux/modememulator.h"
+#include "cicada/scheduler.h"
+#include "cicada/tick.h"
+#include <cstring>
+
+#include <MQTTClient.h>
+
+using namespace Cicada;
+
+static const int MESSAGES = 200;
+static const E_TICK_TYPE ROUND_TRIP_TIME = 150;
+
+static E_TICK_TYPE simulatedTime = 0;
+
+// The benchmarks don't link a platform tick, everything runs on simulated time
+E_TICK_TYPE eTickFunction()
+{
+    return simulatedTime;
+}
+
+static void yieldFunction(void* scheduler)
+{
+    simulatedTime++;
+    for (int i = 0; i < 2; i++)
+        ((Scheduler*)scheduler)->runTask();
+}
+
+// Just enough of an MQTT broker for a client subscribed to its own topic,
+// with QoS 0 only
+struct BrokerStub
+{
+    uint8_t stream[2 * EMULATOR_PAYLOAD_SIZE];
+    Size fill;
+};
+
+static bool packetSize(const uint8_t* data, Size size, Size& header, Size& length)
+{
+    // Fixed header byte, then the remaining length as variable length integer
+    header = 1;
+    length = 0;
+    for (Size shift = 0; header < size && header < 5; shift += 7) {
+        uint8_t byte = data[header++];
+        length |= (Size)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return header + length <= size;
+    }
+    return false;
+}
+
+static Size broker(uint8_t link, const uint8_t* data, Size size, uint8_t* reply, Size maxSize,
+    void* context)
+{
+    (void)link;
+    BrokerStub& stub = *(BrokerStub*)context;
+    if (size > sizeof(stub.stream) - stub.fill)
+        return 0;
+
+    memcpy(stub.stream + stub.fill, data, size);
+    stub.fill += size;
+
+    Size pos = 0, replySize = 0, header, length;
+    while (packetSize(stub.stream + pos, stub.fill - pos, header, length)) {
+        const uint8_t* packet = stub.stream + pos;
+        const uint8_t* body = packet + header;
+        Size packetSize = header + length;
+        uint8_t ack[5];
+        Size ackSize = 0;
+
+        switch (packet[0] >> 4) {
+        case 1: // CONNECT -> CONNACK
+            ack[0] = 0x20, ack[1] = 2, ack[2] = 0, ack[3] = 0;
+            ackSize = 4;
+            break;
+
+        case 3: // PUBLISH, forwarded to the subscriber unchanged
+            if (replySize + packetSize <= maxSize) {
+                memcpy(reply + replySize, packet, packetSize);
+                replySize += packetSize;
+            }
+            break;
+
+        case 8: // SUBSCRIBE -> SUBACK, granting QoS 0
+            ack[0] = 0x90, ack[1] = 3, ack[2] = body[0], ack[3] = body[1], ack[4] = 0;
+            ackSize = 5;
+            break;
+
+        case 10: // UNSUBSCRIBE -> UNSUBACK
+            ack[0] = 0xb0, ack[1] = 2, ack[2] = body[0], ack[3] = body[1];
+            ackSize = 4;
+            break;
+
+        case 12: // PINGREQ -> PINGRESP
+            ack[0] = 0xd0, ack[1] = 0;
+            ackSize = 2;
+            break;
+
+        default:
+            break;
+        }
+
+        if (ackSize && replySize + ackSize <= maxSize) {
+            memcpy(reply + replySize, ack, ackSize);
+            replySize += ackSize;
+        }
+        pos += packetSize;
+    }
+
+    memmove(stub.stream, stub.stream + pos, stub.fill - pos);
+    stub.fill -= pos;
+    return replySize;
+}
+
+static int arrived = 0;
+
+static void messageArrived(MQTT::MessageData& md)
+{
+    (void)md;
+    arrived++;
+}
+
+void runMqttBenchmarks(BenchmarkReport& report)
+{
+    ModemEmulator modem(ModemEmulator::sim7x00, eTickFunction);
+    Sim7x00CommDevice commDev(modem);
+    Task* taskList[] = { &commDev, &modem, NULL };
+    Scheduler scheduler(&eTickFunction, taskList);
+    BlockingCommDevice network(commDev, eTickFunction, yieldFunction, &scheduler);
+    MQTT::Client<BlockingCommDevice, MQTTCountdown> client(network);
+
+    static BrokerStub stub;
+    modem.setPeer(broker, &stub);
+    modem.setRoundTripTime(ROUND_TRIP_TIME);
+
+    // Network attach and TCP connect
+    E_TICK_TYPE start = eTickFunction();
+    commDev.setApn("internet");
+    commDev.setHostPort("broker.example.com", 1883);
+    commDev.connect();
+    while (!commDev.isConnected())
+        yieldFunction(&scheduler);
+    E_TICK_TYPE connectTime = eTickFunction() - start;
+
+    const char* topic = "cicada/benchmark";
+    MQTTPacket_connectData data = MQTTPacket_connectData_initializer;
+    data.MQTTVersion = 3;
+    data.clientID.cstring = (char*)"cicada-benchmark";
+    if (client.connect(data) != 0 || client.subscribe(topic, MQTT::QOS0, messageArrived) != 0) {
+        fprintf(stderr, "MQTT setup against the broker stub failed\n");
+        return;
+    }
+
+    char payload[64];
+    memset(payload, 'x', sizeof(payload));
+    MQTT::Message message;
+    message.qos = MQTT::QOS0;
+    message.retained = false;
+    message.dup = false;
+    message.payload = payload;
+    message.payloadlen = sizeof(payload);
+
+    // Publish one message at a time and wait for it to come back
+    uint32_t sentBefore = modem.bytesSent();
+    start = eTickFunction();
+    std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < MESSAGES; i++) {
+        client.publish(topic, message);
+        while (arrived == i)
+            client.yield(10);
+    }
+    std::chrono::steady_clock::time_point wallEnd = std::chrono::steady_clock::now();
+    E_TICK_TYPE loopTime = eTickFunction() - start;
+
+    double ns = std::chrono::duration<double, std::nano>(wallEnd - wallStart).count();
+    report.add("mqtt_publish_subscribe_roundtrip", MESSAGES, ns / MESSAGES)
+        .metric("payload_size", sizeof(payload))
+        .metric("rtt_ms", ROUND_TRIP_TIME)
+        .metric("connect_ms", connectTime)
+        .metric("roundtrip_ms", (double)loopTime / MESSAGES)
+        .metric("bytes_sent_per_message", (double)(modem.bytesSent() - sentBefore) / MESSAGES);
+
+    client.disconnect();
+    commDev.disconnect();
+    while (!commDev.isIdle())
+        yieldFunction(&scheduler);
+}
@@ -0,0 +1,70 @@
+/*
+ * E-Lib
+ * Copyright (C) 2019 EnAccess
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+/*
+ * Overhead of Scheduler::runTask() for due and for not yet due tasks.
+ */
+
+#include "benchmark.h"
+#include "cicada/scheduler.h"
+
+using namespace Cicada;
+
+static const uint64_t ITERATIONS = 5000000;
+
+static E_TICK_TYPE benchmarkTick = 0;
+
+static E_TICK_TYPE benchmarkTickFunction()
+{
+    return benchmarkTick;
+}
+
+class CountingTask : public Task
+{
+  public:
+    CountingTask(uint16_t delay) : Task(delay) {}
+
+    void run()
+    {
+        benchmarkSink = benchmarkSink + 1;
+    }
+};
+
+void runSchedulerBenchmarks(BenchmarkReport& report)
+{
+    CountingTask a(0), b(0), c(0), d(0);
+    Task* dueTasks[] = { &a, &b, &c, &d, NULL };
+    Scheduler dueScheduler(&benchmarkTickFunction, dueTasks);
+
+    report.measure("scheduler_runtask_due", ITERATIONS, [&]() { dueScheduler.runTask(); })
+        .metric("tasks", 4);
+
+    // The tick doesn't advance, so these tasks are never due again
+    CountingTask e(1000), f(1000), g(1000), h(1000);
+    Task* idleTasks[] = { &e, &f, &g, &h, NULL };
+    Scheduler idleScheduler(&benchmarkTickFunction, idleTasks);
+
+    report.measure("scheduler_runtask_not_due", ITERATIONS, [&]() { idleScheduler.runTask(); })
+        .metric("tasks", 4);
+}
@@ -22,66 +22,39 @@
  */
 
 #include "cicada/bufferedserial.h"
-#include "cicada/irq.h"
 #include <cstdint>
+#include <cstring>
 
 using namespace Cicada;
 
-BufferedSerial::BufferedSerial() {}
+BufferedSerial::BufferedSerial() :
+    _receiveTask(NULL)
+{
+}
 
 Size BufferedSerial::bytesAvailable() const
 {
-    eDisableInterrupts();
-    Size availableData = _readBuffer.bytesAvailable();
-    eEnableInterrupts();
-
-    return availableData;
+    return _readBuffer.bytesAvailable();
 }
 
 Size BufferedSerial::spaceAvailable() const
 {
-    eDisableInterrupts();
-    Size spaceAvailable = _writeBuffer.spaceAvailable();
-    eEnableInterrupts();
-
-    return spaceAvailable;
+    return _writeBuffer.spaceAvailable();
 }
 
 Size BufferedSerial::read(uint8_t* data, Size size)
 {
-    Size avail = bytesAvailable();
-    if (size > avail)
-        size = avail;
-
-    Size readCount = 0;
-
-    while (readCount < size) {
-        data[readCount++] = read();
-    }
-
-    return readCount;
+    return _readBuffer.pull((char*)data, size);
 }
 
 uint8_t BufferedSerial::read()
 {
-    eDisableInterrupts();
-    uint8_t c = _readBuffer.pull();
-    eEnableInterrupts();
-
-    return c;
+    return _readBuffer.pull();
 }
 
 Size BufferedSerial::write(const uint8_t* data, Size size)
 {
-    Size space = spaceAvailable();
-    if (size > space)
-        size = space;
-
-    Size writeCount = 0;
-
-    while (writeCount < size) {
-        copyToBuffer(data[writeCount++]);
-    }
+    Size writeCount = _writeBuffer.push((const char*)data, size);
 
     startTransmit();
 
@@ -90,55 +63,36 @@ Size BufferedSerial::write(const uint8_t* data, Size size)
 
 Size BufferedSerial::write(const uint8_t* data)
 {
-    Size space = spaceAvailable();
-
-    Size writeCount = 0;
-
-    while (data[writeCount] != '\0' && writeCount < space) {
-        copyToBuffer(data[writeCount++]);
-    }
+    Size writeCount = _writeBuffer.push((const char*)data, strlen((const char*)data));
 
     startTransmit();
 
     return writeCount;
 }
 
-void BufferedSerial::write(uint8_t data)
+bool BufferedSerial::write(uint8_t data)
 {
-    copyToBuffer(data);
+    // Pushing into a full buffer would touch the consumer's read index
+    bool written = !_writeBuffer.isFull();
+    if (written)
+        _writeBuffer.push((char)data);
+
     startTransmit();
-}
 
-void BufferedSerial::copyToBuffer(uint8_t data)
-{
-    eDisableInterrupts();
-    _writeBuffer.push(data);
-    eEnableInterrupts();
+    return written;
 }
 
 bool BufferedSerial::canReadLine() const
 {
-    eDisableInterrupts();
-    Size lines = _readBuffer.numBufferedLines();
-    eEnableInterrupts();
-
-    return lines > 0;
+    return _readBuffer.numBufferedLines() > 0;
 }
 
 Size BufferedSerial::readLine(uint8_t* data, Size size)
 {
-    Size readCount = 0;
-    uint8_t c = '\0';
-
     if (size == 0)
         return 0;
 
-    while (bytesAvailable() && c != '\n') {
-        c = read();
-        if (readCount < size - 1) {
-            data[readCount++] = c;
-        }
-    }
+    Size readCount = _readBuffer.readLine((char*)data, size - 1);
     data[readCount] = '\0';
 
     return readCount;
@@ -146,9 +100,7 @@ Size BufferedSerial::readLine(uint8_t* data, Size size)
 
 void BufferedSerial::flushReceiveBuffers()
 {
-    eDisableInterrupts();
     _readBuffer.flush();
-    eEnableInterrupts();
 }
 
 Size BufferedSerial::bufferSize()
@@ -158,16 +110,42 @@ Size BufferedSerial::bufferSize()
 
 void BufferedSerial::transferToAndFromBuffer()
 {
-    if (_writeBuffer.bytesAvailable()) {
-        if (rawWrite(_writeBuffer.read())) {
-            _writeBuffer.pull();
-        }
+    // Two rounds each, in case the data wraps around the end of the buffer
+    for (int i = 0; i < 2; i++) {
+        Size size;
+        const char* data = _writeBuffer.linearReadSpan(size);
+        if (size == 0)
+            break;
+
+        Size written = rawWrite((const uint8_t*)data, size);
+        _writeBuffer.commitRead(written);
+        if (written < size)
+            break;
     }
 
-    if (!_readBuffer.isFull()) {
-        uint8_t data;
-        if (rawRead(data)) {
-            _readBuffer.push(data);
-        }
+    for (int i = 0; i < 2; i++) {
+        Size size;
+        char* space = _readBuffer.linearWriteSpan(size);
+        if (size == 0)
+            break;
+
+        Size read = rawRead((uint8_t*)space, size);
+        _readBuffer.commitWrite(read);
+        if (read > 0)
+            notifyReceiveTask();
+        if (read < size)
+            break;
     }
 }
+
+void BufferedSerial::setReceiveTask(Task* task)
+{
+    _receiveTask = task;
+}
+
+void BufferedSerial::notifyReceiveTask()
+{
+    Task* task = _receiveTask;
+    if (task)
+        task->notify();
+}
@@ -37,6 +37,11 @@ namespace Cicada {
  * class, as well as reading/writing to/from the buffers. When adding
  * a new serial device, inherit from this class. You need to implement
  * the pure virtual functions from ISerial.
+ *
+ * The read and write buffers are lock-free single producer / single
+ * consumer rings. transferToAndFromBuffer() may run in an interrupt
+ * handler or a separate thread, while the application uses the read and
+ * write methods, without any critical sections.
  */
 
 class BufferedSerial : public IBufferedSerial
@@ -56,7 +61,7 @@ class BufferedSerial : public IBufferedSerial
 
     virtual Size write(const uint8_t* data) override;
 
-    virtual void write(uint8_t data) override;
+    virtual bool write(uint8_t data) override;
 
     virtual bool canReadLine() const override;
 
@@ -75,18 +80,25 @@ class BufferedSerial : public IBufferedSerial
 
     virtual Size bufferSize() override;
 
+    virtual void setReceiveTask(Task* task) override;
+
     /*!
      * Actually perform read/write to the underlying
-     * raw serial device.
+     * raw serial device. Moves as much data as the raw device and the
+     * buffers allow, using the block variants of rawRead() / rawWrite().
      */
     void transferToAndFromBuffer();
 
   protected:
-    LineCircularBuffer<E_SERIAL_BUFFERSIZE> _readBuffer;
-    LineCircularBuffer<E_SERIAL_BUFFERSIZE> _writeBuffer;
+    /*!
+     * Notifies the task set with setReceiveTask(). Call this after
+     * adding data to the read buffer outside of transferToAndFromBuffer().
+     */
+    void notifyReceiveTask();
 
-  private:
-    void copyToBuffer(uint8_t data);
+    LineCircularBuffer<E_SERIAL_BUFFERSIZE> _readBuffer;
+    CircularBuffer<char, E_SERIAL_BUFFERSIZE> _writeBuffer;
+    Task* _receiveTask;
 };
 
 /*!
@@ -97,11 +109,14 @@ class BufferedSerial : public IBufferedSerial
  * from the serial hardware. On platforms where an interrupt is not available
  * and the serial hardware needs to be polled instead (like Unix termios),
  * this class can be used to do the polling in a Task and and it to
- * the Scheduler.
+ * the Scheduler. As the task runs with a delay of 0, the scheduler never
+ * becomes idle then, see Scheduler.
  */
 class BufferedSerialTask : public BufferedSerial, public Task
 {
   public:
+    BufferedSerialTask() : Task(0, E_SERIAL_TASK_PRIORITY) {}
+
     /*!
      * Calls BufferedSerial::performReadWrite().
      */
@@ -21,69 +21,181 @@
  *
  */
 
+
 #ifndef CIRCULAR_BUFFER_H
 #define CIRCULAR_BUFFER_H
 
 #include "cicada/types.h"
+#include <atomic>
 #include <cstdint>
+#include <cstring>
 
 namespace Cicada {
 
+/*!
+ * \class RingIndex
+ *
+ * Index arithmetic used by CircularBuffer. The read and write indices
+ * are never reset, so a full buffer can be told apart from an empty
+ * one without a separate element counter.
+ *
+ * The indices are of type E_RING_INDEX_TYPE, which must be small enough
+ * for atomic loads and stores without locking on the target.
+ *
+ * This generic version is used for buffer sizes which are not a power
+ * of two. The indices run from 0 to 2 * BUFFER_SIZE - 1 and wrap with a
+ * compare and subtract.
+ */
+template <Size BUFFER_SIZE, bool POWER_OF_TWO = (BUFFER_SIZE & (BUFFER_SIZE - 1)) == 0>
+struct RingIndex
+{
+    typedef E_RING_INDEX_TYPE Type;
+
+    static Size offset(Type index)
+    {
+        return index < BUFFER_SIZE ? index : index - BUFFER_SIZE;
+    }
+
+    static Type advance(Type index, Size count)
+    {
+        index += count;
+        if (index >= 2 * BUFFER_SIZE)
+            index -= 2 * BUFFER_SIZE;
+
+        return index;
+    }
+
+    static Size distance(Type from, Type to)
+    {
+        return to >= from ? to - from : to + 2 * BUFFER_SIZE - from;
+    }
+};
+
+/*!
+ * Specialization for power of two buffer sizes. The indices run freely
+ * and the buffer offset is obtained by masking, so no branches are needed.
+ */
+template <Size BUFFER_SIZE>
+struct RingIndex<BUFFER_SIZE, true>
+{
+    typedef E_RING_INDEX_TYPE Type;
+
+    static Size offset(Type index)
+    {
+        return index & (BUFFER_SIZE - 1);
+    }
+
+    static Type advance(Type index, Size count)
+    {
+        return (Type)(index + count);
+    }
+
+    static Size distance(Type from, Type to)
+    {
+        return (Type)(to - from);
+    }
+};
+
+/*!
+ * Selects the class the CircularBuffer hooks are called on:
+ * the derived class if given, the buffer itself otherwise.
+ */
+template <class Base, class Derived>
+struct CircularBufferSelf
+{
+    typedef Derived Type;
+};
+
+template <class Base>
+struct CircularBufferSelf<Base, void>
+{
+    typedef Base Type;
+};
+
 /*!
  * \class CircularBuffer
  *
  * Implementation of a circular buffer.
+ *
+ * Bulk push() and pull() copy data with at most two memcpy() calls, one
+ * for each contiguous part of the buffer. For filling or draining the
+ * buffer in place, linearWriteSpan() / commitWrite() and
+ * linearReadSpan() / commitRead() give direct access to the underlying
+ * storage. T must therefore be a trivially copyable type.
+ *
+ * The buffer is safe for one producer and one consumer running
+ * concurrently, for example an interrupt handler and the main loop, or
+ * two threads. The producer owns the write index and the consumer the
+ * read index, which are published with release/acquire semantics, so no
+ * critical sections are required. Producer methods are push(),
+ * linearWriteSpan() and commitWrite(). Consumer methods are pull(),
+ * read(), linearReadSpan(), commitRead() and flush(). Note that push()
+ * of a single element into a full buffer drops the oldest element, which
+ * is a consumer operation. Check for space first if the buffer is shared.
+ *
+ * The class has no virtual methods. Choose a power of two for BUFFER_SIZE
+ * to get mask based index wrapping. Classes extending the buffer pass
+ * themselves as Derived and implement any of the hooks
+ * `onWrite(const T* data, Size size)` and `onRead(const T* data, Size size)`,
+ * which are called with the elements added to or removed from the buffer.
+ * onWrite() runs in the producer's context after the elements have been
+ * published, onRead() in the consumer's context before the space is
+ * released. See LineCircularBuffer
+ * for an example.
  */
 
-template <typename T, Size BUFFER_SIZE>
+template <typename T, Size BUFFER_SIZE, class Derived = void>
 class CircularBuffer
 {
   public:
     CircularBuffer() :
-        _writeHead(0),
-        _readHead(0),
-        _availableData(0),
+        _writeIndex(0),
+        _readIndex(0),
         _buffer()
     { }
 
-    virtual ~CircularBuffer()
-    { }
-
     /*!
      * Push data into the buffer. Data is copied.
      * \param pointer to the data to be copied into the buffer
      * \param size number of elements in data
      */
-    //TODO: Check if virtual is appropriate
-    virtual Size push(const T* data, Size size)
+    Size push(const T* data, Size size)
     {
-        if (size > spaceAvailable())
-            size = spaceAvailable();
+        Size available = spaceAvailable();
+        if (size > available)
+            size = available;
 
-        Size writeCount = 0;
+        IndexType writeIndex = _writeIndex.load(std::memory_order_relaxed);
+        Size writeHead = Index::offset(writeIndex);
+        Size firstPart = BUFFER_SIZE - writeHead;
+        if (firstPart > size)
+            firstPart = size;
 
-        while (writeCount < size) {
-            _buffer[_writeHead] = data[writeCount++];
-            incrementOrResetHead(_writeHead);
-        }
-        _availableData += writeCount;
+        memcpy(_buffer + writeHead, data, firstPart * sizeof(T));
+        memcpy(_buffer, data + firstPart, (size - firstPart) * sizeof(T));
 
-        return writeCount;
+        _writeIndex.store(Index::advance(writeIndex, size), std::memory_order_release);
+        self().onWrite(data, size);
+
+        return size;
     }
 
     /*!
      * Pushes one elementinto the buffer. This function
      * does not check for available space in the buffer.
-     * If there is no available space, an existing element
+     * If there is no available space, the oldest element
      * will be overwritten.
      * \param data Element to push into the buffer
      */
-    virtual void push(T data)
+    void push(T data)
     {
-        _buffer[_writeHead] = data;
-        incrementOrResetHead(_writeHead);
-        if (_availableData < BUFFER_SIZE)
-            _availableData++;
+        if (isFull())
+            pull();
+
+        IndexType writeIndex = _writeIndex.load(std::memory_order_relaxed);
+        _buffer[Index::offset(writeIndex)] = data;
+        _writeIndex.store(Index::advance(writeIndex, 1), std::memory_order_release);
+        self().onWrite(&data, 1);
     }
 
     /*!
@@ -92,20 +204,25 @@ class CircularBuffer
      * \param size Maximum size to pull
      * \return Actual number of elements pulled from the buffer
      */
-    virtual Size pull(T* data, Size size)
+    Size pull(T* data, Size size)
     {
-        if (size > bytesAvailable())
-            size = bytesAvailable();
+        Size available = bytesAvailable();
+        if (size > available)
+            size = available;
 
-        Size readCount = 0;
+        IndexType readIndex = _readIndex.load(std::memory_order_relaxed);
+        Size readHead = Index::offset(readIndex);
+        Size firstPart = BUFFER_SIZE - readHead;
+        if (firstPart > size)
+            firstPart = size;
 
-        while (readCount < size) {
-            data[readCount++] = _buffer[_readHead];
-            incrementOrResetHead(_readHead);
-        }
-        _availableData -= readCount;
+        memcpy(data, _buffer + readHead, firstPart * sizeof(T));
+        memcpy(data + firstPart, _buffer, (size - firstPart) * sizeof(T));
 
-        return readCount;
+        self().onRead(data, size);
+        _readIndex.store(Index::advance(readIndex, size), std::memory_order_release);
+
+        return size;
     }
 
     /*!
@@ -114,12 +231,15 @@ class CircularBuffer
      * be returned.
      * \return The element pulled from the buffer
      */
-    virtual T pull()
+    T pull()
     {
-        T data = _buffer[_readHead];
-        incrementOrResetHead(_readHead);
-        if (_availableData > 0)
-            _availableData--;
+        bool empty = isEmpty();
+        IndexType readIndex = _readIndex.load(std::memory_order_relaxed);
+        T data = _buffer[Index::offset(readIndex)];
+        if (!empty) {
+            self().onRead(&data, 1);
+            _readIndex.store(Index::advance(readIndex, 1), std::memory_order_release);
+        }
 
         return data;
     }
@@ -130,73 +250,183 @@ class CircularBuffer
      * in which case old data will be returned.
      * \return The element read from the buffer
      */
-    virtual T read()
+    T read() const
+    {
+        return _buffer[Index::offset(_readIndex.load(std::memory_order_relaxed))];
+    }
+
+    /*!
+     * Returns the largest contiguous block of elements which can be read
+     * in place. After processing the data, call commitRead() to remove
+     * it from the buffer.
+     * \param size Set to the number of elements available at the
+     * returned pointer
+     * \param offset Number of elements to skip from the read position.
+     * Use it to get the second part of the data after the buffer wraps
+     * around, or to look ahead without removing data.
+     * \return Pointer to the first element to be read
+     */
+    const T* linearReadSpan(Size& size, Size offset = 0) const
+    {
+        Size available = bytesAvailable();
+        if (offset > available)
+            offset = available;
+
+        Size readHead = Index::offset(
+            Index::advance(_readIndex.load(std::memory_order_relaxed), offset));
+        size = BUFFER_SIZE - readHead;
+        if (size > available - offset)
+            size = available - offset;
+
+        return _buffer + readHead;
+    }
+
+    /*!
+     * Returns the largest contiguous block of free space which can be
+     * written in place. After filling in the data, call commitWrite()
+     * to make it available for reading.
+     * \param size Set to the number of elements which can be written
+     * at the returned pointer
+     * \return Pointer to the first free element
+     */
+    T* linearWriteSpan(Size& size)
+    {
+        Size writeHead = Index::offset(_writeIndex.load(std::memory_order_relaxed));
+        size = BUFFER_SIZE - writeHead;
+        Size available = spaceAvailable();
+        if (size > available)
+            size = available;
+
+        return _buffer + writeHead;
+    }
+
+    /*!
+     * Removes elements read with linearReadSpan() from the buffer.
+     * \param size Number of elements to remove. Must not be larger
+     * than the size returned by linearReadSpan().
+     */
+    void commitRead(Size size)
+    {
+        Size spanSize;
+        const T* span = linearReadSpan(spanSize);
+        if (size > spanSize)
+            size = spanSize;
+
+        self().onRead(span, size);
+        _readIndex.store(Index::advance(_readIndex.load(std::memory_order_relaxed), size),
+            std::memory_order_release);
+    }
+
+    /*!
+     * Makes elements written with linearWriteSpan() available for reading.
+     * \param size Number of elements written. Must not be larger
+     * than the size returned by linearWriteSpan().
+     */
+    void commitWrite(Size size)
+    {
+        Size spanSize;
+        const T* span = linearWriteSpan(spanSize);
+        if (size > spanSize)
+            size = spanSize;
+
+        _writeIndex.store(Index::advance(_writeIndex.load(std::memory_order_relaxed), size),
+            std::memory_order_release);
+        self().onWrite(span, size);
+    }
+
+    /*!
+     * Removes elements from the buffer without copying them.
+     * \param size Number of elements to remove
+     * \return Number of elements actually removed
+     */
+    Size discard(Size size)
     {
-        return _buffer[_readHead];
+        Size discarded = 0;
+        while (discarded < size) {
+            Size spanSize;
+            linearReadSpan(spanSize);
+            if (spanSize == 0)
+                break;
+            if (spanSize > size - discarded)
+                spanSize = size - discarded;
+
+            commitRead(spanSize);
+            discarded += spanSize;
+        }
+        return discarded;
     }
 
     /*!
-     * Empties the buffer by resetting all counters to zero.
+     * Empties the buffer by discarding all available elements.
      */
-    virtual void flush()
+    void flush()
     {
-        _writeHead = 0;
-        _readHead = 0;
-        _availableData = 0;
+        Size size;
+        linearReadSpan(size);
+        commitRead(size);
+        linearReadSpan(size);
+        commitRead(size);
     }
 
     /*!
      * \return true if the buffer is empty, false if there is data in it
      */
-    virtual bool isEmpty() const
+    bool isEmpty() const
     {
-        return _availableData == 0;
+        return bytesAvailable() == 0;
     }
 
     /*!
      * \return true if the buffer is full, false if there is still space
      */
-    virtual bool isFull() const
+    bool isFull() const
     {
-        return _availableData == BUFFER_SIZE;
+        return bytesAvailable() == BUFFER_SIZE;
     }
 
     /*!
      * \return Number of available elements in the buffer
      */
-    virtual Size bytesAvailable() const
+    Size bytesAvailable() const
     {
-        return _availableData;
+        return Index::distance(
+            _readIndex.load(std::memory_order_acquire), _writeIndex.load(std::memory_order_acquire));
     }
 
     /*!
      * \return Number of available space in the buffer
      */
-    virtual Size spaceAvailable() const
+    Size spaceAvailable() const
     {
-        return BUFFER_SIZE - _availableData;
+        return BUFFER_SIZE - bytesAvailable();
     }
 
     /*!
      * \return size of the buffer, which was specified at compile time
      */
-    virtual Size size() const
+    Size size() const
     {
         return BUFFER_SIZE;
     }
 
+  protected:
+    // Default hooks, hidden by the derived class if required
+    void onWrite(const T*, Size) { }
+    void onRead(const T*, Size) { }
+
   private:
-    Size _writeHead;
-    Size _readHead;
-    Size _availableData;
-    T _buffer[BUFFER_SIZE];
+    typedef RingIndex<BUFFER_SIZE> Index;
+    typedef typename Index::Type IndexType;
+    typedef typename CircularBufferSelf<CircularBuffer, Derived>::Type Self;
 
-    void incrementOrResetHead(Size& head)
+    Self& self()
     {
-        head++;
-        if (head >= BUFFER_SIZE)
-            head = 0;
+        return static_cast<Self&>(*this);
     }
+
+    std::atomic<IndexType> _writeIndex;
+    std::atomic<IndexType> _readIndex;
+    T _buffer[BUFFER_SIZE];
 };
 
 }
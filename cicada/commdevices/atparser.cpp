@@ -0,0 +1,231 @@
+/*
+ * E-Lib
+ * Copyright (C) 2019 EnAccess
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "cicada/commdevices/atparser.h"
+#include <cstddef>
+
+using namespace Cicada;
+
+namespace {
+
+struct AtPrefix
+{
+    const char* prefix;
+    uint8_t length;
+    AtReply reply;
+};
+
+#define E_AT_PREFIX(STR, REPLY)                                                                   \
+    {                                                                                              \
+        STR, sizeof(STR) - 1, REPLY                                                                \
+    }
+
+// Sorted by byte value, see isValidTable()
+constexpr AtPrefix prefixTable[] = {
+    E_AT_PREFIX("+CDNSGIP: 0", atCdnsgipFail),
+    E_AT_PREFIX("+CDNSGIP: 1", atCdnsgip),
+    E_AT_PREFIX("+CIPOPEN: ", atCipopen),
+    E_AT_PREFIX("+CIPRXGET: 1", atCiprxgetData),
+    E_AT_PREFIX("+CIPRXGET: 2", atCiprxgetRead),
+    E_AT_PREFIX("+CIPRXGET: 4", atCiprxgetLength),
+    E_AT_PREFIX("+CME ERROR", atCmeError),
+    E_AT_PREFIX("+CSQ: ", atCsq),
+    E_AT_PREFIX("+IPCLOSE: ", atIpclose),
+    E_AT_PREFIX("+NETCLOSE: ", atNetclose),
+    E_AT_PREFIX("+NETOPEN: ", atNetopen),
+    E_AT_PREFIX("+PDP: DEACT", atPdpDeact),
+    E_AT_PREFIX(">", atPrompt),
+    E_AT_PREFIX("CLOSE OK", atCloseOk),
+    E_AT_PREFIX("CLOSED", atClosed),
+    E_AT_PREFIX("CONNECT FAIL", atConnectFail),
+    E_AT_PREFIX("CONNECT OK", atConnectOk),
+    E_AT_PREFIX("ERROR", atError),
+    E_AT_PREFIX("OK", atOk),
+    E_AT_PREFIX("RDY", atRdy),
+    E_AT_PREFIX("SEND OK", atSendOk),
+    E_AT_PREFIX("SHUT OK", atShutOk),
+};
+
+const Size prefixTableSize = sizeof(prefixTable) / sizeof(prefixTable[0]);
+
+// True if a sorts before b and is not a prefix of it
+constexpr bool precedes(const char* a, const char* b)
+{
+    return *a == '\0' ? false
+                      : (*a != *b ? (unsigned char)*a < (unsigned char)*b : precedes(a + 1, b + 1));
+}
+
+// If neighbours are sorted and no prefix of each other, no entry is a
+// prefix of any other entry, so a line matches at most one entry
+constexpr bool isValidTable(const AtPrefix* table, Size size)
+{
+    return size < 2
+        || (precedes(table[0].prefix, table[1].prefix) && isValidTable(table + 1, size - 1));
+}
+
+static_assert(isValidTable(prefixTable, prefixTableSize),
+    "AT prefix table must be sorted and free of common prefixes");
+
+// Compares the line with a prefix: < 0 if the line sorts before it,
+// 0 if the line starts with it, > 0 if the line sorts after it
+inline int comparePrefix(const char* line, const AtPrefix& entry)
+{
+    for (uint8_t i = 0; i < entry.length; i++) {
+        unsigned char l = line[i];
+        unsigned char p = entry.prefix[i];
+        if (l != p)
+            return l < p ? -1 : 1;
+    }
+    return 0;
+}
+}
+
+AtReply AtParser::classify(const char* line, Size& prefixLength)
+{
+    // Replies for a link in multi connection mode start with "<link>, "
+    Size linkLength = 0;
+    if (line[0] >= '0' && line[0] <= '9' && line[1] == ',' && line[2] == ' ') {
+        linkLength = 3;
+        line += linkLength;
+    }
+
+    Size low = 0;
+    Size high = prefixTableSize;
+
+    while (low < high) {
+        Size mid = (low + high) / 2;
+        int cmp = comparePrefix(line, prefixTable[mid]);
+        if (cmp == 0) {
+            prefixLength = linkLength + prefixTable[mid].length;
+            return prefixTable[mid].reply;
+        }
+
+        if (cmp < 0)
+            high = mid;
+        else
+            low = mid + 1;
+    }
+
+    prefixLength = 0;
+    return atUnknown;
+}
+
+bool AtParser::isUnsolicited(AtReply reply)
+{
+    switch (reply) {
+    case atCiprxgetData:
+    case atIpclose:
+    case atPdpDeact:
+    case atClosed:
+    case atRdy:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+const char* AtParser::replyName(AtReply reply)
+{
+    for (Size i = 0; i < prefixTableSize; i++) {
+        if (prefixTable[i].reply == reply)
+            return prefixTable[i].prefix;
+    }
+    return NULL;
+}
+
+Size AtParser::formatUint(char* buffer, uint32_t value)
+{
+    char digits[10];
+    Size count = 0;
+
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    for (Size i = 0; i < count; i++)
+        buffer[i] = digits[count - 1 - i];
+    buffer[count] = '\0';
+
+    return count;
+}
+
+void AtTokenizer::skipSeparator()
+{
+    while (*_pos == ' ')
+        _pos++;
+
+    if (*_pos == ',') {
+        _pos++;
+        while (*_pos == ' ')
+            _pos++;
+    }
+}
+
+bool AtTokenizer::readUint(uint32_t& value)
+{
+    skipSeparator();
+
+    if (*_pos < '0' || *_pos > '9')
+        return false;
+
+    value = 0;
+    while (*_pos >= '0' && *_pos <= '9')
+        value = value * 10 + (*_pos++ - '0');
+
+    return true;
+}
+
+bool AtTokenizer::readField(char* buffer, Size size)
+{
+    skipSeparator();
+
+    char end = ',';
+    if (*_pos == '"') {
+        end = '"';
+        _pos++;
+    } else if (*_pos == '\0' || *_pos == '\r' || *_pos == '\n') {
+        return false;
+    }
+
+    Size length = 0;
+    while (*_pos && *_pos != end && *_pos != '\r' && *_pos != '\n') {
+        if (buffer && length + 1 < size)
+            buffer[length++] = *_pos;
+        _pos++;
+    }
+
+    // A quoted field must be closed
+    if (end == '"') {
+        if (*_pos != '"')
+            return false;
+        _pos++;
+    }
+
+    if (buffer && size)
+        buffer[length] = '\0';
+
+    return true;
+}
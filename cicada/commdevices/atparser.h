@@ -0,0 +1,157 @@
+/*
+ * E-Lib
+ * Copyright (C) 2019 EnAccess
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef EATPARSER_H
+#define EATPARSER_H
+
+#include "cicada/types.h"
+#include <cstdint>
+
+namespace Cicada {
+
+/*!
+ * Known replies and unsolicited result codes of the supported modems.
+ */
+enum AtReply : uint8_t {
+    atUnknown = 0,
+    atCdnsgipFail,
+    atCdnsgip,
+    atCipopen,
+    atCiprxgetData,
+    atCiprxgetRead,
+    atCiprxgetLength,
+    atCmeError,
+    atCsq,
+    atIpclose,
+    atNetclose,
+    atNetopen,
+    atPdpDeact,
+    atCloseOk,
+    atClosed,
+    atConnectFail,
+    atConnectOk,
+    atSendOk,
+    atPrompt,
+    atError,
+    atOk,
+    atRdy,
+    atShutOk
+};
+
+/*!
+ * \class AtParser
+ *
+ * Classifies modem reply lines by their prefix. The prefixes are kept in
+ * a sorted table, which is checked at compile time to be free of
+ * prefixes that are a prefix of another entry. So there is at most one
+ * match, which is found with a binary search instead of a chain of
+ * strncmp() calls.
+ */
+class AtParser
+{
+  public:
+    /*!
+     * Finds the reply type of a line. A leading link number, as in
+     * "1, SEND OK", is skipped and included in the prefix length.
+     * \param line Line received from the modem
+     * \param prefixLength Set to the length of the matched prefix,
+     * 0 if nothing matched
+     * \return Reply type, atUnknown if no prefix matched
+     */
+    static AtReply classify(const char* line, Size& prefixLength);
+
+    /*!
+     * Tells if a reply is an unsolicited result code, which the modem may
+     * send at any time and not only in response to a command.
+     * \param reply Reply type as returned by classify()
+     * \return true for unsolicited result codes
+     */
+    static bool isUnsolicited(AtReply reply);
+
+    /*!
+     * Gives the prefix a reply type is recognised by, for tools naming
+     * replies in logs and traces.
+     * \param reply Reply type
+     * \return The prefix, NULL for atUnknown and invalid values
+     */
+    static const char* replyName(AtReply reply);
+
+    /*!
+     * Writes an unsigned integer as decimal string, replacing sprintf().
+     * \param buffer Buffer with space for at least 11 characters
+     * \param value Value to write
+     * \return Number of characters written, without the terminating '\0'
+     */
+    static Size formatUint(char* buffer, uint32_t value);
+};
+
+/*!
+ * \class AtTokenizer
+ *
+ * Reads comma separated fields from a reply line without allocating
+ * memory or using sscanf(). Usually constructed with the part of the line
+ * after the prefix found by AtParser::classify().
+ */
+class AtTokenizer
+{
+  public:
+    /*!
+     * \param pos Position in the line to start reading from
+     */
+    AtTokenizer(const char* pos) : _pos(pos) {}
+
+    /*!
+     * Reads an unsigned integer field. Leading spaces and one separating
+     * comma are skipped.
+     * \param value Set to the parsed value
+     * \return true if a number was found
+     */
+    bool readUint(uint32_t& value);
+
+    /*!
+     * Reads a field, which may be quoted. Leading spaces and one separating
+     * comma are skipped. The result is always '\0' terminated and truncated
+     * if the buffer is too small.
+     * \param buffer Buffer to copy the field into, may be NULL to skip it
+     * \param size Size of the buffer
+     * \return true if a field was found
+     */
+    bool readField(char* buffer, Size size);
+
+    /*!
+     * \return Current read position
+     */
+    inline const char* position() const
+    {
+        return _pos;
+    }
+
+  private:
+    void skipSeparator();
+
+    const char* _pos;
+};
+}
+
+#endif
@@ -23,54 +23,132 @@
 
 #include "cicada/commdevices/ipcommdevice.h"
 #include <cstddef>
+#include <cstring>
 
 using namespace Cicada;
 
-IPCommDevice::IPCommDevice() :
+IPSocket::IPSocket() :
     _host(NULL),
     _port(0),
     _stateBooleans(LINE_READ),
     _connectState(notConnected),
-    _waitForReply(NULL)
-{}
+    _datagram(false),
+    _deviceTask(NULL)
+{
+    _ip[0] = '\0';
+}
+
+IPCommDevice::IPCommDevice() :
+    Task(0, E_COMMDEVICE_TASK_PRIORITY),
+    _waitForReply(NULL),
+    _connectPhase(LinkStats::connectPhases),
+    _connectPhaseStart(0),
+    _commandPending(false),
+    _commandTime(0)
+{
+    _deviceTask = this;
+    resetLinkStats();
+}
+
+LinkStats IPCommDevice::linkStats() const
+{
+    return _linkStats;
+}
+
+void IPCommDevice::resetLinkStats()
+{
+    memset(&_linkStats, 0, sizeof(_linkStats));
+}
+
+void IPCommDevice::requestReset(LinkStats::ResetCause cause)
+{
+    _stateBooleans |= RESET_PENDING;
+    _linkStats.resets[cause]++;
+
+    // Neither the pending command nor the connect will complete
+    _commandPending = false;
+    _connectPhase = LinkStats::connectPhases;
+}
 
-void IPCommDevice::setHostPort(const char* host, uint16_t port)
+void IPCommDevice::enterConnectPhase(uint8_t phase)
+{
+    // Phases follow each other, LinkStats::connectPhases ends the last one.
+    // Entering the current phase again, e.g. when a command is retried,
+    // doesn't restart it.
+    if (phase == _connectPhase)
+        return;
+
+    if (_connectPhase < LinkStats::connectPhases)
+        _linkStats.connectPhaseTime[_connectPhase] = lastRun() - _connectPhaseStart;
+
+    _connectPhase = phase;
+    _connectPhaseStart = lastRun();
+}
+
+void IPCommDevice::startCommandRtt()
+{
+    // With pipelining, a command may be sent before the previous one
+    // completed, the round trip then counts from the first one
+    if (!_commandPending) {
+        _commandPending = true;
+        _commandTime = lastRun();
+    }
+}
+
+void IPCommDevice::endCommandRtt()
+{
+    if (!_commandPending)
+        return;
+
+    _commandPending = false;
+    E_TICK_TYPE rtt = lastRun() - _commandTime;
+    Size bucket = 0;
+    while (rtt > 0 && bucket < E_LINK_STATS_RTT_BUCKETS - 1) {
+        rtt >>= 1;
+        bucket++;
+    }
+    _linkStats.commandRtt[bucket]++;
+}
+
+void IPSocket::setHostPort(const char* host, uint16_t port)
 {
     _host = host;
     _port = port;
 }
 
-bool IPCommDevice::connect()
+bool IPSocket::connect()
 {
     if (_host == NULL || _port == 0)
         return false;
 
     _stateBooleans |= CONNECT_PENDING;
+    notifyDevice();
 
     return true;
 }
 
-void IPCommDevice::disconnect()
+void IPSocket::disconnect()
 {
     _stateBooleans |= DISCONNECT_PENDING;
+    notifyDevice();
 }
 
-bool IPCommDevice::isConnected()
+bool IPSocket::isConnected()
 {
     return _connectState == connected || _connectState == transmitting;
 }
 
-bool IPCommDevice::isIdle()
+bool IPSocket::isIdle()
 {
     return _connectState == notConnected;
 }
 
-Size IPCommDevice::bytesAvailable() const
+Size IPSocket::bytesAvailable() const
 {
     return _readBuffer.bytesAvailable();
 }
 
-Size IPCommDevice::spaceAvailable() const
+Size IPSocket::spaceAvailable() const
 {
     if (_connectState != connected)
         return 0;
@@ -78,15 +156,31 @@ Size IPCommDevice::spaceAvailable() const
     return _writeBuffer.spaceAvailable();
 }
 
-Size IPCommDevice::read(uint8_t* data, Size maxSize)
+Size IPSocket::read(uint8_t* data, Size maxSize)
 {
-    return _readBuffer.pull(data, maxSize);
+    Size size = _readBuffer.pull(data, maxSize);
+
+    // The device may wait for room to receive more
+    if (size)
+        notifyDevice();
+
+    return size;
 }
 
-Size IPCommDevice::write(const uint8_t* data, Size size)
+Size IPSocket::write(const uint8_t* data, Size size)
 {
     if (_connectState != connected)
         return 0;
 
-    return _writeBuffer.push(data, size);
+    Size written = _writeBuffer.push(data, size);
+    if (written)
+        notifyDevice();
+
+    return written;
+}
+
+void IPSocket::notifyDevice()
+{
+    if (_deviceTask)
+        _deviceTask->notify();
 }
@@ -36,14 +36,32 @@
 #define IP_CONNECTED (1 << 4)
 #define LINE_READ (1 << 5)
 #define SERIAL_LOCKED (1 << 6)
+#define RECEIVE_BLOCKED (1 << 7)
+
+// Datagrams are kept in the buffers with their length in front
+#define DATAGRAM_HEADER_SIZE 2
 
 namespace Cicada {
 
-class IPCommDevice : public IIPCommDevice, public Task
+class SimCommDevice;
+
+/*!
+ * \class IPSocket
+ *
+ * A single IP connection with its own read and write buffers. The comm
+ * device itself is the first socket. Additional sockets are attached to a
+ * comm device which supports several connections at a time, see
+ * SimCommDevice::attachSocket(). They can be connected while the comm
+ * device is connected and share its modem.
+ *
+ * Requests of the application, like connecting or writing data, notify
+ * the comm device, as it waits for an event while it has nothing to do.
+ */
+class IPSocket : public IIPCommDevice
 {
   public:
-    IPCommDevice();
-    virtual ~IPCommDevice() {}
+    IPSocket();
+    virtual ~IPSocket() {}
 
     virtual void setHostPort(const char* host, uint16_t port);
     virtual bool connect();
@@ -56,6 +74,8 @@ class IPCommDevice : public IIPCommDevice, public Task
     virtual Size write(const uint8_t* data, Size size);
 
   protected:
+    friend class SimCommDevice;
+
     enum ConnectState {
         notConnected,
         intermediate,
@@ -65,13 +85,86 @@ class IPCommDevice : public IIPCommDevice, public Task
         dnsError,
     };
 
+    void notifyDevice();
+
     CircularBuffer<uint8_t, E_NETWORK_BUFFERSIZE> _readBuffer;
     CircularBuffer<uint8_t, E_NETWORK_BUFFERSIZE> _writeBuffer;
     const char* _host;
+    char _ip[16];
     uint16_t _port;
     uint8_t _stateBooleans;
     ConnectState _connectState;
+    bool _datagram;
+    Task* _deviceTask;
+};
+
+/*!
+ * Running statistics of the link between a comm device and its modem,
+ * see IPCommDevice::linkStats(). Times are in ticks.
+ */
+struct LinkStats
+{
+    enum ConnectPhase {
+        phaseNetwork, /**< NETOPEN on SIM7x00, CSTT to CIFSR on SIM800 */
+        phaseDns,     /**< CDNSGIP, or 0 if the address was cached */
+        phaseOpen,    /**< CIPOPEN / CIPSTART until connected */
+        connectPhases
+    };
+
+    enum ResetCause {
+        resetOnError,      /**< ERROR or +CME ERROR reply */
+        resetConnectFail,  /**< Opening the connection failed */
+        resetDnsFail,      /**< Host name lookup failed */
+        resetNetworkLost,  /**< +PDP: DEACT */
+        resetModemRestart, /**< Unexpected RDY */
+        resetCauses
+    };
+
+    uint64_t bytesSent;         /**< Payload bytes handed to the modem */
+    uint64_t bytesReceived;     /**< Payload bytes read from the modem */
+    uint32_t sendRoundTrips;    /**< Number of AT+CIPSEND commands */
+    uint32_t receiveRoundTrips; /**< Number of AT+CIPRXGET=2 and =4 commands */
+
+    /*!
+     * Round-trip times of AT commands, from sending until the driver
+     * has the complete reply. Bucket 0 counts times of 0, bucket i times
+     * from 2^(i-1) to 2^i - 1, the last bucket also all longer ones.
+     */
+    uint32_t commandRtt[E_LINK_STATS_RTT_BUCKETS];
+
+    E_TICK_TYPE connectPhaseTime[connectPhases]; /**< Duration in the last connect */
+    uint32_t resets[resetCauses];                /**< Number of modem resets */
+};
+
+class IPCommDevice : public IPSocket, public Task
+{
+  public:
+    IPCommDevice();
+    virtual ~IPCommDevice() {}
+
+    /*!
+     * \return A copy of the link statistics collected since construction
+     * or the last call to resetLinkStats()
+     */
+    LinkStats linkStats() const;
+
+    /*!
+     * Clears the link statistics.
+     */
+    void resetLinkStats();
+
+  protected:
+    void requestReset(LinkStats::ResetCause cause);
+    void enterConnectPhase(uint8_t phase);
+    void startCommandRtt();
+    void endCommandRtt();
+
     const char* _waitForReply;
+    LinkStats _linkStats;
+    uint8_t _connectPhase;
+    E_TICK_TYPE _connectPhaseStart;
+    bool _commandPending;
+    E_TICK_TYPE _commandTime;
 };
 }
 
@@ -0,0 +1,111 @@
+/*
+ * E-Lib
+ * Copyright (C) 2019 EnAccess
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "cicada/commdevices/modemtrace.h"
+
+using namespace Cicada;
+
+const uint8_t ModemTrace::version;
+const Size ModemTrace::headerSize;
+const Size ModemTrace::eventSize;
+
+static inline void writeUint16(uint8_t* buffer, uint16_t value)
+{
+    buffer[0] = value & 0xff;
+    buffer[1] = value >> 8;
+}
+
+static inline bool endOfName(const char* c)
+{
+    return *c == '\0' || *c == ',' || *c == '"';
+}
+
+// 32 bit FNV-1a over a command name up to its arguments
+static uint32_t hashName(uint32_t hash, const char* name)
+{
+    for (const char* c = name; !endOfName(c); c++) {
+        if (*c == '=' && endOfName(c + 1))
+            break;
+
+        hash ^= (uint8_t)*c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+uint16_t ModemTrace::commandId(const char* cmd, const char* suffix)
+{
+    if (cmd[0] == 'A' && cmd[1] == 'T')
+        cmd += 2;
+
+    uint32_t hash = hashName(2166136261u, cmd);
+    if (suffix)
+        hash = hashName(hash, suffix);
+
+    return (uint16_t)(hash ^ (hash >> 16));
+}
+
+Size ModemTrace::dump(uint8_t* buffer, Size size) const
+{
+    if (size < headerSize)
+        return 0;
+
+    Size count = _events.bytesAvailable();
+    if (count > (size - headerSize) / eventSize)
+        count = (size - headerSize) / eventSize;
+    if (count > UINT16_MAX)
+        count = UINT16_MAX;
+
+    buffer[0] = 'C';
+    buffer[1] = 'T';
+    buffer[2] = version;
+    buffer[3] = _driver;
+    writeUint16(buffer + 4, count);
+    writeUint16(buffer + 6, 0);
+
+    // Skip the oldest events if not all of them fit
+    Size offset = _events.bytesAvailable() - count;
+    uint8_t* pos = buffer + headerSize;
+    while (count > 0) {
+        Size spanSize;
+        const TraceEvent* span = _events.linearReadSpan(spanSize, offset);
+        if (spanSize > count)
+            spanSize = count;
+
+        for (Size i = 0; i < spanSize; i++) {
+            uint32_t time = span[i].time;
+            writeUint16(pos, time & 0xffff);
+            writeUint16(pos + 2, time >> 16);
+            pos[4] = span[i].type;
+            pos[5] = span[i].arg0;
+            writeUint16(pos + 6, span[i].arg1);
+            pos += eventSize;
+        }
+
+        offset += spanSize;
+        count -= spanSize;
+    }
+
+    return pos - buffer;
+}
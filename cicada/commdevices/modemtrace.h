@@ -0,0 +1,156 @@
+/*
+ * E-Lib
+ * Copyright (C) 2019 EnAccess
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef EMODEMTRACE_H
+#define EMODEMTRACE_H
+
+#include "cicada/circularbuffer.h"
+#include "cicada/types.h"
+#include <cstdint>
+
+namespace Cicada {
+
+/*!
+ * Kinds of events recorded by ModemTrace.
+ */
+enum TraceEventType : uint8_t {
+    traceEventState = 1, /**< arg0 = send state, arg1 = reply state */
+    traceEventCommand,   /**< arg1 = ModemTrace::commandId() of the command */
+    traceEventReply      /**< arg0 = AtReply of a line read from the modem */
+};
+
+/*!
+ * Drivers the states in a trace belong to, so the decoder can name them.
+ */
+enum TraceDriver : uint8_t {
+    traceSim7x00 = 0,
+    traceSim800
+};
+
+struct TraceEvent
+{
+    E_TICK_TYPE time;
+    uint8_t type;
+    uint8_t arg0;
+    uint16_t arg1;
+};
+
+/*!
+ * \class ModemTrace
+ *
+ * Binary trace of a modem driver. State transitions, AT commands and
+ * the classes of the replies are stored as fixed size events in a ring
+ * buffer of E_TRACE_BUFFER_SIZE entries, overwriting the oldest ones.
+ * Recording an event doesn't format anything, so the trace can be left
+ * enabled on production units. dump() serializes the events into a
+ * compact format, which is decoded on the host with tools/tracedecode:
+ *
+ * | Offset | Size | Content                                     |
+ * |--------|------|---------------------------------------------|
+ * | 0      | 2    | Magic "CT"                                  |
+ * | 2      | 1    | Format version, currently 1                 |
+ * | 3      | 1    | TraceDriver                                 |
+ * | 4      | 2    | Number of events, little endian             |
+ * | 6      | 2    | Reserved, 0                                 |
+ * | 8      | 8*n  | Events, oldest first: time (uint32), type,  |
+ * |        |      | arg0, arg1 (uint16), all little endian      |
+ */
+class ModemTrace
+{
+  public:
+    static const uint8_t version = 1;
+    static const Size headerSize = 8;
+    static const Size eventSize = 8;
+
+    /*!
+     * \param driver Driver the recorded states belong to
+     */
+    ModemTrace(TraceDriver driver = traceSim7x00) : _driver(driver) {}
+
+    /*!
+     * Sets the driver the recorded states belong to.
+     */
+    void setDriver(TraceDriver driver)
+    {
+        _driver = driver;
+    }
+
+    /*!
+     * Records an event.
+     * \param time Tick of the event
+     * \param type Kind of event
+     * \param arg0 First argument, depending on the type
+     * \param arg1 Second argument, depending on the type
+     */
+    inline void record(E_TICK_TYPE time, TraceEventType type, uint8_t arg0, uint16_t arg1 = 0)
+    {
+        TraceEvent event = { time, type, arg0, arg1 };
+        _events.push(event);
+    }
+
+    /*!
+     * Calculates the ID of an AT command, which is a 16 bit hash of
+     * the command name. A leading "AT" is skipped, the name ends before
+     * the first ',' or '"' and a '=' followed by them. So the ID of
+     * "AT+CIPRXGET=2," is the one of "+CIPRXGET=2", and the ID of
+     * "AT+CDNSGIP=\"" the one of "+CDNSGIP".
+     * \param cmd Command as sent to the modem
+     * \param suffix Optional continuation of the command
+     * \return ID of the command
+     */
+    static uint16_t commandId(const char* cmd, const char* suffix = NULL);
+
+    /*!
+     * \return Number of recorded events
+     */
+    Size size() const
+    {
+        return _events.bytesAvailable();
+    }
+
+    /*!
+     * Serializes the trace, see the class description for the format.
+     * If the buffer is too small for all events, the newest ones are
+     * written.
+     * \param buffer Buffer to write to
+     * \param size Size of the buffer
+     * \return Number of bytes written, 0 if the buffer is too small for the header
+     */
+    Size dump(uint8_t* buffer, Size size) const;
+
+    /*!
+     * Removes all events.
+     */
+    void clear()
+    {
+        _events.flush();
+    }
+
+  private:
+    CircularBuffer<TraceEvent, E_TRACE_BUFFER_SIZE> _events;
+    TraceDriver _driver;
+};
+}
+
+#endif
@@ -30,9 +30,24 @@
 
 using namespace Cicada;
 
-Sim7x00CommDevice::Sim7x00CommDevice(IBufferedSerial& serial) : SimCommDevice(serial) {}
+Sim7x00CommDevice::Sim7x00CommDevice(IBufferedSerial& serial) :
+    SimCommDevice(serial),
+    _sendsPending(0)
+{
+    _maxSendLength = 1500;
+    _maxReceiveLength = 1500;
+    _datagramPeerInSend = true;
+    if (_maxSockets > 10)
+        _maxSockets = 10;
+}
 
 void Sim7x00CommDevice::run()
+{
+    runStateMachine();
+    traceStates();
+}
+
+void Sim7x00CommDevice::runStateMachine()
 {
     // If the serial device is net yet open, try to open it
     if (!_serial.isOpen()) {
@@ -52,12 +67,15 @@ void Sim7x00CommDevice::run()
         _stateBooleans = LINE_READ;
         _bytesToRead = 0;
         _bytesToReceive = 0;
-        _bytesToWrite = 0;
-        if (_sendState >= connecting && _sendState <= receiving)
+        abortSending();
+        _sendsPending = 0;
+        resetSockets();
+        if (_sendState >= connecting && _sendState <= commandMode)
             _sendState = connecting;
         else
             _sendState = notConnected;
         const char str[] = "AT+CRESET";
+        commandSent(str);
         _serial.write((const uint8_t*)str, sizeof(str) - 1);
         _serial.write((const uint8_t*)_lineEndStr);
         _replyState = okReply;
@@ -68,33 +86,47 @@ void Sim7x00CommDevice::run()
         return;
     }
 
-    // Buffer reply from the modem
+    // Buffer reply from the modem, unsolicited result codes are handled on the way
     bool parseLine = fillLineBuffer();
 
+    // An unsolicited result code may have requested a reset
+    if (_stateBooleans & RESET_PENDING)
+        return;
+
     // Check if there is a reply from the modem
     if (parseLine) {
 
         // Log the current modem states
         logStates(_sendState, _replyState);
 
-        // If sent a command, process standard reply
-        if (_waitForReply) {
+        // Sent chunks are acknowledged with OK, with pipelining possibly
+        // after the prompt for the next one. If sent a command, process
+        // standard reply.
+        if (_sendsPending && _lineReply == atOk) {
+            _sendsPending--;
+        } else if (_waitForReply) {
             if (strncmp(_lineBuffer, _waitForReply, strlen(_waitForReply)) == 0) {
                 _waitForReply = NULL;
-            } else if (strncmp(_lineBuffer, "ERROR", 5) == 0) {
-                _stateBooleans |= RESET_PENDING;
-                _connectState = generalError;
+            } else if (_lineReply == atError) {
                 _waitForReply = NULL;
-                return;
+                if (_socket != this && _replyState == cdnsgip) {
+                    // Only the lookup for an additional socket failed
+                    closeSocket(IPCommDevice::dnsError);
+                } else {
+                    requestReset(LinkStats::resetOnError);
+                    _connectState = generalError;
+                    return;
+                }
             }
         }
 
         // Process replies which need special treatment
+        uint32_t error, link;
         switch (_replyState) {
         case netopen:
             if (_waitForReply == NULL) {
                 _replyState = okReply;
-            } else if (strncmp(_lineBuffer, "+NETOPEN: 1", 11) == 0) {
+            } else if (_lineReply == atNetopen && lineUint(0, error) && error == 1) {
                 setDelay(2000);
                 _sendState = sendNetopen;
                 _waitForReply = NULL;
@@ -103,9 +135,25 @@ void Sim7x00CommDevice::run()
             }
             break;
 
+        case expectConnect:
+            // CONNECT, with the baud rate on some modems, once in data mode
+            if (_lineReply == atConnectFail) {
+                uncacheHost();
+                requestReset(LinkStats::resetConnectFail);
+                _connectState = generalError;
+                return;
+            } else if (strncmp(_lineBuffer, "CONNECT", 7) == 0) {
+                _replyState = okReply;
+            }
+            break;
+
         case cdnsgip:
             if (parseDnsReply()) {
                 _replyState = okReply;
+            } else if (socketLookupFailed() && _waitForReply == NULL) {
+                closeSocket(IPCommDevice::dnsError);
+                _replyState = okReply;
+                _sendState = connected;
             }
             break;
 
@@ -113,9 +161,18 @@ void Sim7x00CommDevice::run()
             if (_waitForReply == NULL) {
                 _replyState = okReply;
             } else {
-                if (strncmp(_lineBuffer, "+CIPOPEN: 0,", 12) == 0) {
-                    _stateBooleans |= RESET_PENDING;
-                    _connectState = generalError;
+                // +CIPOPEN: <link>,<error>, success was matched above
+                if (_lineReply == atCipopen && lineUint(0, link) && link == _link) {
+                    uncacheHost();
+                    if (_socket == this) {
+                        requestReset(LinkStats::resetConnectFail);
+                        _connectState = generalError;
+                    } else {
+                        closeSocket(IPCommDevice::generalError);
+                        _waitForReply = NULL;
+                        _replyState = okReply;
+                        _sendState = connected;
+                    }
                 }
             }
             break;
@@ -133,6 +190,17 @@ void Sim7x00CommDevice::run()
             }
             break;
 
+        case sendAck:
+            if (_lineReply == atError) {
+                requestReset(LinkStats::resetOnError);
+                _connectState = generalError;
+                return;
+            } else if (_sendsPending == 0) {
+                endTransfer();
+                _replyState = okReply;
+            }
+            break;
+
         case csq:
             if (parseCsq()) {
                 _replyState = okReply;
@@ -141,11 +209,6 @@ void Sim7x00CommDevice::run()
         default:
             break;
         }
-
-        // In connected state, check for new data or IP connection close
-        if (_sendState >= connected) {
-            checkConnectionState("+IPCLOSE: 0,");
-        }
     }
 
     // When disconnecting was requested, flush read buffer first
@@ -157,12 +220,15 @@ void Sim7x00CommDevice::run()
     if (_waitForReply || _replyState != okReply)
         return;
 
+    // The reply to the last command is complete
+    endCommandRtt();
+
     // Don't go on if space in write buffer is low
     if (_serial.spaceAvailable() < 20)
         return;
 
     // When signal strength was requested, send the command to the modem
-    if (_rssi == UINT8_MAX && _stateBooleans & LINE_READ) {
+    if (_rssi == UINT8_MAX && _stateBooleans & LINE_READ && _sendState != sendData) {
         _replyState = csq;
         _waitForReply = _okStr;
         sendCommand("AT+CSQ");
@@ -188,6 +254,7 @@ void Sim7x00CommDevice::run()
 
     case sendCgsockcont: {
         const char str[] = "AT+CGSOCKCONT=1,\"IP\",\"";
+        commandSent(str);
         _serial.write((const uint8_t*)str, sizeof(str) - 1);
         _serial.write((const uint8_t*)_apn, strlen(_apn));
         _serial.write((const uint8_t*)_quoteEndStr);
@@ -206,10 +273,11 @@ void Sim7x00CommDevice::run()
     case sendCipmode:
         _waitForReply = _okStr;
         _sendState = sendNetopen;
-        sendCommand("AT+CIPMODE=0");
+        sendCommand(_transparentMode ? "AT+CIPMODE=1" : "AT+CIPMODE=0");
         break;
 
     case sendNetopen:
+        enterConnectPhase(LinkStats::phaseNetwork);
         setDelay(10);
         _waitForReply = "+NETOPEN: 0";
         _sendState = sendCiprxget;
@@ -220,11 +288,14 @@ void Sim7x00CommDevice::run()
     case sendCiprxget:
         _waitForReply = _okStr;
         _sendState = sendDnsQuery;
-        sendCommand("AT+CIPRXGET=1");
+        sendCommand(_transparentMode ? "AT+CIPRXGET=0" : "AT+CIPRXGET=1");
         break;
 
     case sendDnsQuery:
-        if (SimCommDevice::sendDnsQuery()) {
+        enterConnectPhase(LinkStats::phaseDns);
+        if (resolveCached()) {
+            _sendState = sendCipopen;
+        } else if (SimCommDevice::sendDnsQuery()) {
             _replyState = cdnsgip;
             _waitForReply = _okStr;
             _sendState = sendCipopen;
@@ -232,43 +303,80 @@ void Sim7x00CommDevice::run()
         break;
 
     case sendCipopen: {
+        enterConnectPhase(LinkStats::phaseOpen);
         SimCommDevice::sendCipstart("OPEN");
 
-        _replyState = cipopen;
-        _waitForReply = "+CIPOPEN: 0,0";
+        if (_transparentMode) {
+            _replyState = expectConnect;
+        } else {
+            _replyState = cipopen;
+            _waitForReply = linkReply("+CIPOPEN: ", ",0");
+        }
         _sendState = finalizeConnect;
         break;
     }
 
     case finalizeConnect:
+        enterConnectPhase(LinkStats::connectPhases);
         setDelay(0);
-        _connectState = IPCommDevice::connected;
+        setSocketConnected();
         _replyState = okReply;
-        _sendState = connected;
-        _stateBooleans |= IP_CONNECTED;
+        if (_transparentMode) {
+            enterDataMode();
+            _sendState = dataMode;
+        } else {
+            _sendState = connected;
+        }
         break;
 
     case connected:
-        if (_writeBuffer.bytesAvailable()) {
+        switch (nextSocketAction()) {
+        case socketConnect:
+            _sendState = sendDnsQuery;
+            break;
+
+        case socketDisconnect:
+            _waitForReply = linkReply("+CIPCLOSE: ", ",");
+            _sendState = finalizeClose;
+            sendLinkCommand("AT+CIPCLOSE=");
+            break;
+
+        case socketSend:
             if (prepareSending()) {
-                _connectState = IPCommDevice::transmitting;
                 _sendState = sendData;
             }
-        } else if (_stateBooleans & DATA_PENDING) {
-            _stateBooleans &= ~DATA_PENDING;
-            _connectState = IPCommDevice::transmitting;
-            _sendState = sendCiprxget4;
-        } else {
-            handleDisconnect(sendNetclose);
+            break;
+
+        case socketReceive:
+            if (_receiveReadAhead) {
+                // The reply to CIPRXGET=2 tells what's left, no need to ask first
+                _bytesToReceive = _maxReceiveLength;
+                _sendState = sendCiprxget2;
+            } else {
+                _sendState = sendCiprxget4;
+            }
+            break;
+
+        default:
+            if (!handleDisconnect(sendNetclose))
+                waitWhileIdle();
+            break;
         }
         break;
 
         // States after connecting
 
     case sendData:
-        SimCommDevice::sendData();
-        _waitForReply = _okStr;
-        _connectState = IPCommDevice::connected;
+        if (!SimCommDevice::sendData())
+            break;
+        _sendsPending++;
+
+        // Queue the next chunk while the modem acknowledges this one
+        if (_sendPipelining && continueSending() && prepareSending())
+            break;
+
+        // The transfer is done once all chunks are acknowledged
+        _replyState = sendAck;
         _sendState = connected;
         break;
 
@@ -276,7 +384,8 @@ void Sim7x00CommDevice::run()
         _waitForReply = _okStr;
         _sendState = sendCiprxget2;
         _replyState = ciprxget4;
-        sendCommand("AT+CIPRXGET=4,0");
+        _linkStats.receiveRoundTrips++;
+        sendLinkCommand("AT+CIPRXGET=4,");
         break;
 
     case sendCiprxget2:
@@ -287,9 +396,12 @@ void Sim7x00CommDevice::run()
             if (SimCommDevice::sendCiprxget2()) {
                 _sendState = waitReceive;
                 _replyState = ciprxget2;
+            } else if (_bytesToReceive == 0) {
+                // The read buffer is full, the others go first
+                _sendState = connected;
             }
-        } else if (_stateBooleans & IP_CONNECTED) {
-            _connectState = IPCommDevice::connected;
+        } else if (_socket != this || (_stateBooleans & IP_CONNECTED)) {
+            endTransfer();
             _sendState = connected;
         } else {
             _sendState = ipUnconnected;
@@ -301,18 +413,67 @@ void Sim7x00CommDevice::run()
         break;
 
     case receiving:
-        if (_bytesToRead > 0) {
+        if (!(_stateBooleans & LINE_READ)) {
             if (receive()) {
                 _replyState = okReply;
                 _waitForReply = _okStr;
             }
-        } else if (_bytesToReceive > 0) {
+        } else if (othersPending()) {
+            // Give the other sockets a turn
+            yieldReceiving();
+            _sendState = connected;
+        } else if (_bytesToReceive > 0 || _receiveReadAhead) {
             _sendState = sendCiprxget2;
         } else {
             _sendState = sendCiprxget4;
         }
         break;
 
+    case finalizeClose:
+        closeSocket(IPCommDevice::notConnected);
+        _sendState = connected;
+        break;
+
+    case dataMode:
+        if (transferTransparent())
+            break;
+
+        if (!(_stateBooleans & IP_CONNECTED)) {
+            // The modem went back to command mode by itself
+            _stateBooleans |= LINE_READ;
+            _sendState = ipUnconnected;
+        } else if (escapeRequested()) {
+            // No data may pass for the guard time before the escape
+            setDelay(E_ESCAPE_GUARD_TIME);
+            _sendState = escapeGuard;
+        }
+        break;
+
+    case escapeGuard:
+        if (transferTransparent() || !(_stateBooleans & IP_CONNECTED)) {
+            setDelay(0);
+            _sendState = dataMode;
+        } else {
+            sendEscape();
+            _sendState = commandMode;
+        }
+        break;
+
+    case commandMode:
+        if (!(_stateBooleans & IP_CONNECTED)) {
+            _sendState = ipUnconnected;
+            break;
+        }
+
+        if (handleDisconnect(sendNetclose))
+            break;
+
+        // The RSSI was queried above, go back to data mode
+        _replyState = expectConnect;
+        _sendState = finalizeConnect;
+        sendCommand("ATO");
+        break;
+
     case ipUnconnected:
         _connectState = IPCommDevice::intermediate;
         if (handleDisconnect(sendNetclose))
@@ -329,6 +490,7 @@ void Sim7x00CommDevice::run()
         break;
 
     case finalizeDisconnect:
+        closeSockets();
         _connectState = IPCommDevice::notConnected;
         _sendState = notConnected;
         break;
@@ -28,6 +28,45 @@
 #include "cicada/commdevices/simcommdevice.h"
 #include <stdint.h>
 
+// States of the driver, listed once so tools/tracedecode.cpp can name them
+#define E_SIM7X00_REPLY_STATES(STATE)                                                             \
+    STATE(okReply)                                                                                \
+    STATE(csq)                                                                                    \
+    STATE(expectConnect)                                                                          \
+    STATE(netopen)                                                                                \
+    STATE(cdnsgip)                                                                                \
+    STATE(cipopen)                                                                                \
+    STATE(ciprxget4)                                                                              \
+    STATE(ciprxget2)                                                                              \
+    STATE(sendAck)
+
+#define E_SIM7X00_SEND_STATES(STATE)                                                              \
+    STATE(notConnected)                                                                           \
+    STATE(serialError)                                                                            \
+    STATE(dnsError)                                                                               \
+    STATE(connecting)                                                                             \
+    STATE(sendCgsockcont)                                                                         \
+    STATE(sendCsocksetpn)                                                                         \
+    STATE(sendCipmode)                                                                            \
+    STATE(sendNetopen)                                                                            \
+    STATE(sendCiprxget)                                                                           \
+    STATE(sendDnsQuery)                                                                           \
+    STATE(sendCipopen)                                                                            \
+    STATE(finalizeConnect)                                                                        \
+    STATE(connected)                                                                              \
+    STATE(sendData)                                                                               \
+    STATE(sendCiprxget4)                                                                          \
+    STATE(sendCiprxget2)                                                                          \
+    STATE(waitReceive)                                                                            \
+    STATE(receiving)                                                                              \
+    STATE(finalizeClose)                                                                          \
+    STATE(dataMode)                                                                               \
+    STATE(escapeGuard)                                                                            \
+    STATE(commandMode)                                                                            \
+    STATE(ipUnconnected)                                                                          \
+    STATE(sendNetclose)                                                                           \
+    STATE(finalizeDisconnect)
+
 namespace Cicada {
 
 /*!
@@ -48,40 +87,20 @@ class Sim7x00CommDevice : public SimCommDevice
     virtual void run();
 
   private:
+    void runStateMachine();
+
     enum ReplyState {
-        okReply = 0,
-        csq,
-        expectConnect,
-        netopen,
-        cdnsgip,
-        cipopen,
-        ciprxget4,
-        ciprxget2
+#define E_STATE_ENUM(NAME) NAME,
+        E_SIM7X00_REPLY_STATES(E_STATE_ENUM)
     };
 
     enum SendState {
-        notConnected,
-        serialError,
-        dnsError,
-        connecting,
-        sendCgsockcont,
-        sendCsocksetpn,
-        sendCipmode,
-        sendNetopen,
-        sendCiprxget,
-        sendDnsQuery,
-        sendCipopen,
-        finalizeConnect,
-        connected,
-        sendData,
-        sendCiprxget4,
-        sendCiprxget2,
-        waitReceive,
-        receiving,
-        ipUnconnected,
-        sendNetclose,
-        finalizeDisconnect
+        E_SIM7X00_SEND_STATES(E_STATE_ENUM)
+#undef E_STATE_ENUM
     };
+
+    // Chunks sent whose OK didn't arrive yet
+    Size _sendsPending;
 };
 }
 
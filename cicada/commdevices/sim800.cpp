@@ -29,9 +29,25 @@
 
 using namespace Cicada;
 
-Sim800CommDevice::Sim800CommDevice(IBufferedSerial& serial) : SimCommDevice(serial) {}
+Sim800CommDevice::Sim800CommDevice(IBufferedSerial& serial) : SimCommDevice(serial)
+{
+    _maxSendLength = 1460;
+    _maxReceiveLength = 1460;
+    _transparentSingleLink = true;
+#ifdef CICADA_TRACE
+    _trace.setDriver(traceSim800);
+#endif
+    if (_maxSockets > 6)
+        _maxSockets = 6;
+}
 
 void Sim800CommDevice::run()
+{
+    runStateMachine();
+    traceStates();
+}
+
+void Sim800CommDevice::runStateMachine()
 {
     // If the serial device is net yet open, try to open it
     if (!_serial.isOpen()) {
@@ -50,7 +66,8 @@ void Sim800CommDevice::run()
         _serial.flushReceiveBuffers();
         _bytesToRead = 0;
         _bytesToReceive = 0;
-        _bytesToWrite = 0;
+        abortSending();
+        resetSockets();
         _sendState = sendCipshut;
         _replyState = okReply;
         _waitForReply = NULL;
@@ -61,19 +78,21 @@ void Sim800CommDevice::run()
         }
     }
 
-    // Buffer reply from the modem
+    // Buffer reply from the modem, unsolicited result codes are handled on the way
     bool parseLine = fillLineBuffer();
 
+    // An unsolicited result code may have requested a reset
+    if (_stateBooleans & RESET_PENDING)
+        return;
+
     // Parse reply from the modem
     if (parseLine) {
         // Log the current modem states
         logStates(_sendState, _replyState);
 
-        // Handle deactivated or error states
-        if (strncmp(_lineBuffer, "+PDP: DEACT", 11) == 0
-            || strncmp(_lineBuffer, "+CME ERROR", 10) == 0
-            || strncmp(_lineBuffer, "ERROR", 5) == 0) {
-            _stateBooleans |= RESET_PENDING;
+        // Handle error states
+        if (_lineReply == atCmeError || _lineReply == atError) {
+            requestReset(LinkStats::resetOnError);
             _connectState = generalError;
             _waitForReply = NULL;
             return;
@@ -87,7 +106,20 @@ void Sim800CommDevice::run()
         }
 
         // Process replies which need special treatment
+        uint32_t link;
         switch (_replyState) {
+        case expectConnect:
+            // CONNECT, with the baud rate on some modems, once in data mode
+            if (_lineReply == atConnectFail) {
+                uncacheHost();
+                requestReset(LinkStats::resetConnectFail);
+                _connectState = generalError;
+                return;
+            } else if (strncmp(_lineBuffer, "CONNECT", 7) == 0) {
+                _replyState = okReply;
+            }
+            break;
+
         case cifsr: {
             // Validate IP address by checking for three dots
             uint8_t i = 0, p = 0;
@@ -103,15 +135,27 @@ void Sim800CommDevice::run()
         case cdnsgip:
             if (parseDnsReply()) {
                 _replyState = okReply;
+            } else if (socketLookupFailed() && _waitForReply == NULL) {
+                closeSocket(IPCommDevice::dnsError);
+                _replyState = okReply;
+                _sendState = connected;
             }
             break;
 
         case cipstart:
             if (_waitForReply == NULL) {
                 _replyState = okReply;
-            } else if (strncmp(_lineBuffer, "0, CONNECT FAIL", 15) == 0) {
-                _stateBooleans |= RESET_PENDING;
-                _connectState = generalError;
+            } else if (_lineReply == atConnectFail && lineLink(link) && link == _link) {
+                uncacheHost();
+                if (_socket == this) {
+                    requestReset(LinkStats::resetConnectFail);
+                    _connectState = generalError;
+                } else {
+                    closeSocket(IPCommDevice::generalError);
+                    _waitForReply = NULL;
+                    _replyState = okReply;
+                    _sendState = connected;
+                }
             }
             break;
 
@@ -136,11 +180,6 @@ void Sim800CommDevice::run()
         default:
             break;
         }
-
-        // In connected state, check for new data or IP connection close
-        if (_sendState >= connected) {
-            checkConnectionState("0, CLOSED");
-        }
     }
 
     // When disconnecting was requested, flush read buffer
@@ -152,12 +191,15 @@ void Sim800CommDevice::run()
     if (_waitForReply || _replyState != okReply)
         return;
 
+    // The reply to the last command is complete
+    endCommandRtt();
+
     // Don't go on if space in write buffer is low
     if (_serial.spaceAvailable() < 20)
         return;
 
     // When signal strength was requested, send the command to the modem
-    if (_rssi == UINT8_MAX && _stateBooleans & LINE_READ) {
+    if (_rssi == UINT8_MAX && _stateBooleans & LINE_READ && _sendState != sendData) {
         _replyState = csq;
         _waitForReply = _okStr;
         sendCommand("AT+CSQ");
@@ -184,17 +226,26 @@ void Sim800CommDevice::run()
     case sendCiprxget:
         _waitForReply = _okStr;
         _sendState = sendCipmux;
-        sendCommand("AT+CIPRXGET=1");
+        sendCommand(_transparentMode ? "AT+CIPRXGET=0" : "AT+CIPRXGET=1");
         break;
 
     case sendCipmux:
+        // Transparent mode only works with a single connection
+        _waitForReply = _okStr;
+        _sendState = sendCipmode;
+        sendCommand(_transparentMode ? "AT+CIPMUX=0" : "AT+CIPMUX=1");
+        break;
+
+    case sendCipmode:
         _waitForReply = _okStr;
         _sendState = sendCstt;
-        sendCommand("AT+CIPMUX=1");
+        sendCommand(_transparentMode ? "AT+CIPMODE=1" : "AT+CIPMODE=0");
         break;
 
     case sendCstt: {
+        enterConnectPhase(LinkStats::phaseNetwork);
         const char str[] = "AT+CSTT=\"";
+        commandSent(str);
         _serial.write((const uint8_t*)str, sizeof(str) - 1);
         _serial.write((const uint8_t*)_apn);
         _serial.write((const uint8_t*)_quoteEndStr);
@@ -212,6 +263,7 @@ void Sim800CommDevice::run()
 
     case sendCifsr: {
         const char str[] = "AT+CIFSR";
+        commandSent(str);
         _serial.write((const uint8_t*)str, sizeof(str) - 1);
         _serial.write((const uint8_t*)_lineEndStr);
 
@@ -221,7 +273,10 @@ void Sim800CommDevice::run()
     }
 
     case sendDnsQuery:
-        if (SimCommDevice::sendDnsQuery()) {
+        enterConnectPhase(LinkStats::phaseDns);
+        if (resolveCached()) {
+            _sendState = sendCipstart;
+        } else if (SimCommDevice::sendDnsQuery()) {
             _replyState = cdnsgip;
             _waitForReply = _okStr;
             _sendState = sendCipstart;
@@ -229,42 +284,74 @@ void Sim800CommDevice::run()
         break;
 
     case sendCipstart:
+        enterConnectPhase(LinkStats::phaseOpen);
         SimCommDevice::sendCipstart("START");
 
-        _replyState = cipstart;
-        _waitForReply = "0, CONNECT OK";
+        if (_transparentMode) {
+            _replyState = expectConnect;
+        } else {
+            _replyState = cipstart;
+            _waitForReply = linkReply("", ", CONNECT OK");
+        }
         _sendState = finalizeConnect;
         break;
 
     case finalizeConnect:
+        enterConnectPhase(LinkStats::connectPhases);
         setDelay(0);
-        _connectState = IPCommDevice::connected;
+        setSocketConnected();
         _replyState = okReply;
-        _sendState = connected;
-        _stateBooleans |= IP_CONNECTED;
+        if (_transparentMode) {
+            enterDataMode();
+            _sendState = dataMode;
+        } else {
+            _sendState = connected;
+        }
         break;
 
     case connected:
-        if (_writeBuffer.bytesAvailable()) {
+        switch (nextSocketAction()) {
+        case socketConnect:
+            _sendState = sendDnsQuery;
+            break;
+
+        case socketDisconnect:
+            _waitForReply = linkReply("", ", CLOSE OK");
+            _sendState = finalizeClose;
+            sendLinkCommand("AT+CIPCLOSE=");
+            break;
+
+        case socketSend:
             if (prepareSending()) {
-                _connectState = IPCommDevice::transmitting;
                 _sendState = sendData;
             }
-        } else if (_stateBooleans & DATA_PENDING) {
-            _stateBooleans &= ~DATA_PENDING;
-            _connectState = IPCommDevice::transmitting;
-            _sendState = sendCiprxget4;
-        } else {
-            handleDisconnect(sendCipclose);
+            break;
+
+        case socketReceive:
+            if (_receiveReadAhead) {
+                // The reply to CIPRXGET=2 tells what's left, no need to ask first
+                _bytesToReceive = _maxReceiveLength;
+                _sendState = sendCiprxget2;
+            } else {
+                _sendState = sendCiprxget4;
+            }
+            break;
+
+        default:
+            if (!handleDisconnect(sendCipclose))
+                waitWhileIdle();
+            break;
         }
         break;
 
         // States after connecting
 
     case sendData:
-        SimCommDevice::sendData();
-        _waitForReply = "0, SEND OK";
-        _connectState = IPCommDevice::connected;
+        if (!SimCommDevice::sendData())
+            break;
+
+        _waitForReply = linkReply("", ", SEND OK");
+        endTransfer();
         _sendState = connected;
         break;
 
@@ -272,7 +359,8 @@ void Sim800CommDevice::run()
         _waitForReply = _okStr;
         _sendState = sendCiprxget2;
         _replyState = ciprxget4;
-        sendCommand("AT+CIPRXGET=4,0");
+        _linkStats.receiveRoundTrips++;
+        sendLinkCommand("AT+CIPRXGET=4,");
         break;
 
     case sendCiprxget2:
@@ -283,9 +371,12 @@ void Sim800CommDevice::run()
             if (SimCommDevice::sendCiprxget2()) {
                 _sendState = waitReceive;
                 _replyState = ciprxget2;
+            } else if (_bytesToReceive == 0) {
+                // The read buffer is full, the others go first
+                _sendState = connected;
             }
-        } else if (_stateBooleans & IP_CONNECTED) {
-            _connectState = IPCommDevice::connected;
+        } else if (_socket != this || (_stateBooleans & IP_CONNECTED)) {
+            endTransfer();
             _sendState = connected;
         } else {
             _sendState = ipUnconnected;
@@ -297,18 +388,67 @@ void Sim800CommDevice::run()
         break;
 
     case receiving:
-        if (_bytesToRead > 0) {
+        if (!(_stateBooleans & LINE_READ)) {
             if (receive()) {
                 _replyState = okReply;
                 _waitForReply = _okStr;
             }
-        } else if (_bytesToReceive > 0) {
+        } else if (othersPending()) {
+            // Give the other sockets a turn
+            yieldReceiving();
+            _sendState = connected;
+        } else if (_bytesToReceive > 0 || _receiveReadAhead) {
             _sendState = sendCiprxget2;
         } else {
             _sendState = sendCiprxget4;
         }
         break;
 
+    case finalizeClose:
+        closeSocket(IPCommDevice::notConnected);
+        _sendState = connected;
+        break;
+
+    case dataMode:
+        if (transferTransparent())
+            break;
+
+        if (!(_stateBooleans & IP_CONNECTED)) {
+            // The modem went back to command mode by itself
+            _stateBooleans |= LINE_READ;
+            _sendState = ipUnconnected;
+        } else if (escapeRequested()) {
+            // No data may pass for the guard time before the escape
+            setDelay(E_ESCAPE_GUARD_TIME);
+            _sendState = escapeGuard;
+        }
+        break;
+
+    case escapeGuard:
+        if (transferTransparent() || !(_stateBooleans & IP_CONNECTED)) {
+            setDelay(0);
+            _sendState = dataMode;
+        } else {
+            sendEscape();
+            _sendState = commandMode;
+        }
+        break;
+
+    case commandMode:
+        if (!(_stateBooleans & IP_CONNECTED)) {
+            _sendState = ipUnconnected;
+            break;
+        }
+
+        if (handleDisconnect(sendCipclose))
+            break;
+
+        // The RSSI was queried above, go back to data mode
+        _replyState = expectConnect;
+        _sendState = finalizeConnect;
+        sendCommand("ATO");
+        break;
+
     case ipUnconnected:
         _connectState = IPCommDevice::intermediate;
         if (handleDisconnect(finalizeDisconnect))
@@ -319,7 +459,11 @@ void Sim800CommDevice::run()
 
     case sendCipclose:
         _connectState = IPCommDevice::intermediate;
-        if (_stateBooleans & IP_CONNECTED) {
+        if ((_stateBooleans & IP_CONNECTED) && _transparentMode) {
+            _waitForReply = "CLOSE OK";
+            _sendState = sendCipshut;
+            sendCommand("AT+CIPCLOSE");
+        } else if (_stateBooleans & IP_CONNECTED) {
             _waitForReply = "0, CLOSE OK";
             _sendState = sendCipshut;
             sendCommand("AT+CIPCLOSE=0");
@@ -335,6 +479,7 @@ void Sim800CommDevice::run()
         break;
 
     case finalizeDisconnect:
+        closeSockets();
         _connectState = IPCommDevice::notConnected;
         _sendState = notConnected;
         break;
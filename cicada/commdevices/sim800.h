@@ -28,6 +28,46 @@
 #include "cicada/commdevices/simcommdevice.h"
 #include <stdint.h>
 
+// States of the driver, listed once so tools/tracedecode.cpp can name them
+#define E_SIM800_REPLY_STATES(STATE)                                                              \
+    STATE(okReply)                                                                                \
+    STATE(csq)                                                                                    \
+    STATE(expectConnect)                                                                          \
+    STATE(cifsr)                                                                                  \
+    STATE(cdnsgip)                                                                                \
+    STATE(cipstart)                                                                               \
+    STATE(ciprxget4)                                                                              \
+    STATE(ciprxget2)
+
+#define E_SIM800_SEND_STATES(STATE)                                                               \
+    STATE(notConnected)                                                                           \
+    STATE(serialError)                                                                            \
+    STATE(connecting)                                                                             \
+    STATE(sendCiprxget)                                                                           \
+    STATE(sendCipmux)                                                                             \
+    STATE(sendCipmode)                                                                            \
+    STATE(sendCipsprt)                                                                            \
+    STATE(sendCstt)                                                                               \
+    STATE(sendCiicr)                                                                              \
+    STATE(sendCifsr)                                                                              \
+    STATE(sendDnsQuery)                                                                           \
+    STATE(sendCipstart)                                                                           \
+    STATE(finalizeConnect)                                                                        \
+    STATE(connected)                                                                              \
+    STATE(sendData)                                                                               \
+    STATE(sendCiprxget4)                                                                          \
+    STATE(sendCiprxget2)                                                                          \
+    STATE(waitReceive)                                                                            \
+    STATE(receiving)                                                                              \
+    STATE(finalizeClose)                                                                          \
+    STATE(dataMode)                                                                               \
+    STATE(escapeGuard)                                                                            \
+    STATE(commandMode)                                                                            \
+    STATE(ipUnconnected)                                                                          \
+    STATE(sendCipclose)                                                                           \
+    STATE(sendCipshut)                                                                            \
+    STATE(finalizeDisconnect)
+
 namespace Cicada {
 
 /*!
@@ -48,31 +88,16 @@ class Sim800CommDevice : public SimCommDevice
     virtual void run();
 
   private:
-    enum ReplyState { okReply = 0, csq, cifsr, cdnsgip, cipstart, ciprxget4, ciprxget2 };
+    void runStateMachine();
+
+    enum ReplyState {
+#define E_STATE_ENUM(NAME) NAME,
+        E_SIM800_REPLY_STATES(E_STATE_ENUM)
+    };
 
     enum SendState {
-        notConnected,
-        serialError,
-        connecting,
-        sendCiprxget,
-        sendCipmux,
-        sendCipsprt,
-        sendCstt,
-        sendCiicr,
-        sendCifsr,
-        sendDnsQuery,
-        sendCipstart,
-        finalizeConnect,
-        connected,
-        sendData,
-        sendCiprxget4,
-        sendCiprxget2,
-        waitReceive,
-        receiving,
-        ipUnconnected,
-        sendCipclose,
-        sendCipshut,
-        finalizeDisconnect
+        E_SIM800_SEND_STATES(E_STATE_ENUM)
+#undef E_STATE_ENUM
     };
 };
 }
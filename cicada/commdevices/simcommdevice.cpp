@@ -25,7 +25,6 @@
 #include "cicada/commdevices/ipcommdevice.h"
 #include <cinttypes>
 #include <cstddef>
-#include <cstdio>
 #include <cstring>
 
 #ifdef CICADA_DEBUG
@@ -33,6 +32,7 @@
 #endif
 
 #define MIN_SPACE_AVAILABLE 22
+#define MIN_RECEIVE_CHUNK 64
 
 using namespace Cicada;
 
@@ -40,17 +40,77 @@ const char* SimCommDevice::_okStr = "OK";
 const char* SimCommDevice::_lineEndStr = "\r\n";
 const char* SimCommDevice::_quoteEndStr = "\"\r\n";
 
+static bool isDottedQuad(const char* host)
+{
+    uint8_t dots = 0, digits = 0;
+    uint16_t value = 0;
+
+    for (const char* c = host; *c; c++) {
+        if (*c >= '0' && *c <= '9') {
+            value = value * 10 + (*c - '0');
+            if (++digits > 3 || value > 255)
+                return false;
+        } else if (*c == '.' && digits > 0 && dots < 3) {
+            dots++;
+            digits = 0;
+            value = 0;
+        } else {
+            return false;
+        }
+    }
+
+    return dots == 3 && digits > 0;
+}
+
 SimCommDevice::SimCommDevice(IBufferedSerial& serial) :
     _serial(serial),
     _apn(NULL),
     _lbFill(0),
+    _lineReply(atUnknown),
+    _linePrefixLength(0),
+    _socket(this),
+    _link(0),
+    _socketCount(1),
+    _maxSockets(E_MAX_SOCKETS),
     _sendState(0),
     _replyState(0),
     _bytesToWrite(0),
     _bytesToReceive(0),
     _bytesToRead(0),
-    _rssi(99)
-{}
+    _maxSendLength(E_NETWORK_BUFFERSIZE),
+    _maxReceiveLength(E_NETWORK_BUFFERSIZE),
+    _receiveChunkSize(E_SERIAL_BUFFERSIZE / 2),
+    _receiveRequested(0),
+    _receiveBacklog(0),
+    _datagramPeerInSend(false),
+    _datagramHeaderPending(false),
+    _sendPipelining(false),
+    _receiveReadAhead(false),
+    _transparentMode(false),
+    _transparentSingleLink(false),
+    _closedMatch(0),
+    _rssi(99),
+    _dnsCacheTtl(E_DNS_CACHE_TTL)
+{
+    _sockets[0] = this;
+    for (uint8_t i = 1; i < E_MAX_SOCKETS; i++) {
+        _sockets[i] = NULL;
+    }
+
+    for (Size i = 0; i < E_URC_HANDLERS; i++) {
+        _urcHandlers[i].handler = NULL;
+    }
+
+    flushDnsCache();
+
+    // Data from the modem ends waiting while idle
+    _serial.setReceiveTask(this);
+
+#ifdef CICADA_TRACE
+    _tracedSendState = -1;
+    _tracedReplyState = -1;
+#endif
+}
 
 void SimCommDevice::setApn(const char* apn)
 {
@@ -65,6 +125,16 @@ bool SimCommDevice::connect()
     return IPCommDevice::connect();
 }
 
+bool SimCommDevice::attachSocket(IPSocket& socket)
+{
+    if (_socketCount >= _maxSockets)
+        return false;
+
+    _sockets[_socketCount++] = &socket;
+    socket._deviceTask = this;
+    return true;
+}
+
 bool SimCommDevice::serialLock()
 {
     if (_waitForReply || _replyState != 0)
@@ -77,6 +147,7 @@ bool SimCommDevice::serialLock()
 void SimCommDevice::serialUnlock()
 {
     _stateBooleans &= ~SERIAL_LOCKED;
+    notify();
 }
 
 Size SimCommDevice::serialWrite(char* data)
@@ -101,20 +172,296 @@ bool SimCommDevice::fillLineBuffer()
 {
     // Buffer reply from modem in line buffer
     // Returns true when enough data to be parsed is available.
-    if (_stateBooleans & LINE_READ) {
-        while (_serial.bytesAvailable()) {
-            char c = _serial.read();
-            _lineBuffer[_lbFill++] = c;
-            if (c == '\n' || c == '>' || _lbFill == LINE_MAX_LENGTH) {
-                _lineBuffer[_lbFill] = '\0';
-                _lbFill = 0;
+    // Unsolicited result codes are handled right away and not returned.
+    while ((_stateBooleans & LINE_READ) && _serial.bytesAvailable()) {
+        char c = _serial.read();
+        _lineBuffer[_lbFill++] = c;
+        if (c == '\n' || c == '>' || _lbFill == LINE_MAX_LENGTH) {
+            _lineBuffer[_lbFill] = '\0';
+            _lbFill = 0;
+            _lineReply = AtParser::classify(_lineBuffer, _linePrefixLength);
+            traceReply();
+            if (!dispatchUrc())
                 return true;
+
+            // Let the driver reset before reading on
+            if (_stateBooleans & RESET_PENDING)
+                break;
+        }
+    }
+    return false;
+}
+
+bool SimCommDevice::dispatchUrc()
+{
+    if (!AtParser::isUnsolicited(_lineReply))
+        return false;
+
+    for (Size i = 0; i < E_URC_HANDLERS; i++) {
+        if (_urcHandlers[i].handler && _urcHandlers[i].urc == _lineReply)
+            _urcHandlers[i].handler(_lineReply, _lineBuffer, _urcHandlers[i].context);
+    }
+
+    // A reply the driver is waiting for, like RDY after a reset
+    if (_waitForReply && strncmp(_lineBuffer, _waitForReply, strlen(_waitForReply)) == 0)
+        return false;
+
+    logStates(_sendState, _replyState);
+
+    uint32_t link;
+    IPSocket* socket = NULL;
+    if (lineLink(link) && link < _socketCount)
+        socket = _sockets[link];
+    else if (_transparentMode)
+        socket = this;
+
+    switch (_lineReply) {
+    case atCiprxgetData:
+        // +CIPRXGET: 1,<link>
+        if (socket)
+            socket->_stateBooleans |= DATA_PENDING;
+        break;
+
+    case atIpclose:
+    case atClosed:
+        // +IPCLOSE: <link>,<reason> or <link>, CLOSED
+        if (socket && (socket->_stateBooleans & IP_CONNECTED)) {
+            socket->_stateBooleans &= ~IP_CONNECTED;
+            if (socket == _socket)
+                _waitForReply = NULL;
+
+            // Only this device has a state machine to reconnect
+            if (socket != this) {
+                socket->_stateBooleans &= ~DATA_PENDING;
+                socket->_connectState = IPCommDevice::notConnected;
             }
         }
+        break;
+
+    case atPdpDeact:
+        requestReset(LinkStats::resetNetworkLost);
+        _connectState = generalError;
+        _waitForReply = NULL;
+        break;
+
+    case atRdy:
+        // The modem restarted on its own and lost its configuration
+        if (_connectState != IPCommDevice::notConnected) {
+            requestReset(LinkStats::resetModemRestart);
+            _connectState = generalError;
+            _waitForReply = NULL;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    return true;
+}
+
+bool SimCommDevice::lineUint(uint8_t field, uint32_t& value) const
+{
+    // Reads a numeric field of the current line, counted from the prefix
+    AtTokenizer tokenizer(_lineBuffer + _linePrefixLength);
+    for (uint8_t i = 0; i < field; i++) {
+        if (!tokenizer.readField(NULL, 0))
+            return false;
+    }
+    return tokenizer.readUint(value);
+}
+
+bool SimCommDevice::lineLink(uint32_t& link) const
+{
+    // Either "<link>, <reply>" or the first field after the prefix
+    if (_lineBuffer[0] >= '0' && _lineBuffer[0] <= '9' && _lineBuffer[1] == ',') {
+        link = _lineBuffer[0] - '0';
+        return true;
+    }
+    return lineUint(0, link);
+}
+
+SimCommDevice::SocketAction SimCommDevice::nextSocketAction()
+{
+    if (!selectSocket())
+        return socketIdle;
+
+    uint8_t flags = _socket->_stateBooleans;
+
+    if (_socket != this && !(flags & IP_CONNECTED)) {
+        // Nothing to close if the socket isn't open yet
+        if (flags & DISCONNECT_PENDING) {
+            closeSocket(IPCommDevice::notConnected);
+            return nextSocketAction();
+        }
+
+        _socket->_stateBooleans &= ~(CONNECT_PENDING | DATA_PENDING);
+        _socket->_connectState = IPCommDevice::intermediate;
+        return socketConnect;
+    }
+
+    if (_socket != this && (flags & DISCONNECT_PENDING)) {
+        _socket->_connectState = IPCommDevice::intermediate;
+        return socketDisconnect;
+    }
+
+    if (_socket->_writeBuffer.bytesAvailable())
+        return socketSend;
+
+    _socket->_stateBooleans &= ~(DATA_PENDING | RECEIVE_BLOCKED);
+    _socket->_connectState = IPCommDevice::transmitting;
+    return socketReceive;
+}
+
+bool SimCommDevice::selectSocket()
+{
+    // Serve the sockets in turn, starting after the one served last
+    for (uint8_t i = 1; i <= _socketCount; i++) {
+        uint8_t link = (_link + i) % _socketCount;
+        if (socketPending(*_sockets[link])) {
+            _link = link;
+            _socket = _sockets[link];
+            return true;
+        }
     }
     return false;
 }
 
+bool SimCommDevice::socketPending(const IPSocket& socket) const
+{
+    uint8_t flags = socket._stateBooleans;
+
+    // This device connects and disconnects with the modem itself
+    if (&socket == this)
+        return _writeBuffer.bytesAvailable() || receivePending(socket);
+
+    if (flags & IP_CONNECTED) {
+        return socket._writeBuffer.bytesAvailable() || (flags & DISCONNECT_PENDING)
+            || receivePending(socket);
+    }
+
+    return flags & (CONNECT_PENDING | DISCONNECT_PENDING);
+}
+
+bool SimCommDevice::receivePending(const IPSocket& socket) const
+{
+    uint8_t flags = socket._stateBooleans;
+    if (!(flags & DATA_PENDING))
+        return false;
+
+    // After the read buffer ran full, wait for the application to make room
+    if (flags & RECEIVE_BLOCKED)
+        return socket._datagram ? socket._readBuffer.isEmpty() : !socket._readBuffer.isFull();
+
+    return true;
+}
+
+bool SimCommDevice::othersPending() const
+{
+    for (uint8_t i = 0; i < _socketCount; i++) {
+        if (i != _link && socketPending(*_sockets[i]))
+            return true;
+    }
+    return false;
+}
+
+bool SimCommDevice::continueSending() const
+{
+    return _socket->_writeBuffer.bytesAvailable() && !othersPending();
+}
+
+bool SimCommDevice::socketLookupFailed() const
+{
+    return _socket != this && _socket->_connectState == IPCommDevice::dnsError;
+}
+
+void SimCommDevice::setSocketConnected()
+{
+    _socket->_connectState = IPCommDevice::connected;
+    _socket->_stateBooleans |= IP_CONNECTED;
+}
+
+void SimCommDevice::endTransfer()
+{
+    // Additional sockets closed by the remote end are done
+    if (_socket == this || (_socket->_stateBooleans & IP_CONNECTED))
+        _socket->_connectState = IPCommDevice::connected;
+    else
+        _socket->_connectState = IPCommDevice::notConnected;
+}
+
+void SimCommDevice::yieldReceiving()
+{
+    // Fetch the rest when it's this socket's turn again
+    _socket->_stateBooleans |= DATA_PENDING;
+    _bytesToReceive = 0;
+    endTransfer();
+}
+
+void SimCommDevice::closeSocket(ConnectState state)
+{
+    _socket->_stateBooleans &= ~(IP_CONNECTED | DATA_PENDING | DISCONNECT_PENDING);
+    _socket->_connectState = state;
+}
+
+void SimCommDevice::resetSockets()
+{
+    // The modem lost all links, connect the additional sockets again
+    for (uint8_t i = 1; i < _socketCount; i++) {
+        IPSocket* socket = _sockets[i];
+        uint8_t flags = socket->_stateBooleans;
+        socket->_stateBooleans &= ~(IP_CONNECTED | DATA_PENDING | DISCONNECT_PENDING);
+
+        if (flags & DISCONNECT_PENDING) {
+            socket->_connectState = IPCommDevice::notConnected;
+        } else if (socket->_connectState >= IPCommDevice::intermediate
+            && socket->_connectState <= IPCommDevice::transmitting) {
+            socket->_stateBooleans |= CONNECT_PENDING;
+            socket->_connectState = IPCommDevice::intermediate;
+        }
+    }
+
+    _link = 0;
+    _socket = this;
+}
+
+void SimCommDevice::closeSockets()
+{
+    for (uint8_t i = 1; i < _socketCount; i++) {
+        _sockets[i]->_stateBooleans &= ~(IP_CONNECTED | DATA_PENDING | DISCONNECT_PENDING);
+        _sockets[i]->_connectState = IPCommDevice::notConnected;
+    }
+
+    _link = 0;
+    _socket = this;
+}
+
+const char* SimCommDevice::linkReply(const char* prefix, const char* suffix)
+{
+    // Builds the reply expected for the current link, like "1, SEND OK"
+    Size length = strlen(prefix);
+    memcpy(_linkReply, prefix, length);
+    length += AtParser::formatUint(_linkReply + length, _link);
+    strcpy(_linkReply + length, suffix);
+
+    return _linkReply;
+}
+
+void SimCommDevice::writeLink()
+{
+    char linkStr[11];
+    AtParser::formatUint(linkStr, _link);
+    _serial.write((const uint8_t*)linkStr);
+}
+
+void SimCommDevice::sendLinkCommand(const char* cmd)
+{
+    commandSent(cmd);
+    _serial.write((const uint8_t*)cmd);
+    writeLink();
+    _serial.write((const uint8_t*)_lineEndStr);
+}
+
 void SimCommDevice::logStates(int8_t sendState, int8_t replyState)
 {
 #ifdef CICADA_DEBUG
@@ -128,41 +475,95 @@ void SimCommDevice::logStates(int8_t sendState, int8_t replyState)
                    "_waitForReply=NULL, data: %s",
                 sendState, replyState, _lineBuffer);
     }
+#else
+    (void)sendState;
+    (void)replyState;
 #endif
 }
 
-bool SimCommDevice::parseDnsReply()
+bool SimCommDevice::resolveCached()
+{
+    // Returns true if the host's address is known without asking the modem
+    const char* host = _socket->_host;
+    if (isDottedQuad(host)) {
+        strcpy(_socket->_ip, host);
+        return true;
+    }
+
+    for (Size i = 0; i < E_DNS_CACHE_SIZE; i++) {
+        DnsCacheEntry& entry = _dnsCache[i];
+        if (entry.host[0] == '\0' || strcmp(entry.host, host) != 0)
+            continue;
+
+        if (lastRun() - entry.time < _dnsCacheTtl) {
+            strcpy(_socket->_ip, entry.ip);
+            return true;
+        }
+
+        // Expired
+        entry.host[0] = '\0';
+    }
+
+    return false;
+}
+
+void SimCommDevice::cacheHost()
 {
-    if (strncmp(_lineBuffer, "+CDNSGIP: 1", 11) == 0) {
-        char* tmpStr;
-        uint8_t i = 0, q = 0;
+    const char* host = _socket->_host;
+    if (_dnsCacheTtl == 0 || strlen(host) >= E_DNS_CACHE_HOST_LENGTH)
+        return;
 
-        // Validate DNS reply string
-        while (_lineBuffer[i]) {
-            if (_lineBuffer[i++] == '\"')
-                q++;
+    // Take the entry of this host, a free one or the oldest one
+    DnsCacheEntry* slot = NULL;
+    for (Size i = 0; i < E_DNS_CACHE_SIZE && slot == NULL; i++) {
+        if (strcmp(_dnsCache[i].host, host) == 0)
+            slot = &_dnsCache[i];
+    }
+    for (Size i = 0; i < E_DNS_CACHE_SIZE && slot == NULL; i++) {
+        if (_dnsCache[i].host[0] == '\0')
+            slot = &_dnsCache[i];
+    }
+    if (slot == NULL) {
+        slot = &_dnsCache[0];
+        for (Size i = 1; i < E_DNS_CACHE_SIZE; i++) {
+            if (lastRun() - _dnsCache[i].time > lastRun() - slot->time)
+                slot = &_dnsCache[i];
         }
-        if (q < 4 || q > 10) {
+    }
+
+    strcpy(slot->host, host);
+    strcpy(slot->ip, _socket->_ip);
+    slot->time = lastRun();
+}
+
+void SimCommDevice::uncacheHost()
+{
+    // The address didn't work, look it up again next time
+    for (Size i = 0; i < E_DNS_CACHE_SIZE; i++) {
+        if (strcmp(_dnsCache[i].host, _socket->_host) == 0)
+            _dnsCache[i].host[0] = '\0';
+    }
+}
+
+bool SimCommDevice::parseDnsReply()
+{
+    if (_lineReply == atCdnsgip) {
+        // +CDNSGIP: 1,"<host>","<ip>"[,"<ip>"]
+        AtTokenizer tokenizer(_lineBuffer + _linePrefixLength);
+        if (!tokenizer.readField(NULL, 0)
+            || !tokenizer.readField(_socket->_ip, sizeof(_socket->_ip))) {
             // Error in input string
-            _connectState = dnsError;
+            _socket->_connectState = dnsError;
             return false;
         }
-        i = 0, q = 0;
-
-        // Parse IP address
-        while (q < 3)
-            if (_lineBuffer[i++] == '\"')
-                q++;
-        tmpStr = _lineBuffer + i;
-        while (_lineBuffer[i]) {
-            if (_lineBuffer[i] == '\"')
-                _lineBuffer[i] = '\0';
-            i++;
-        }
-        strcpy(_ip, tmpStr);
+        cacheHost();
         return true;
-    } else if (strncmp(_lineBuffer, "+CDNSGIP: 0", 11) == 0) {
-        _stateBooleans |= RESET_PENDING;
+    } else if (_lineReply == atCdnsgipFail) {
+        // A failed lookup for an additional socket only fails the socket
+        if (_socket == this)
+            requestReset(LinkStats::resetDnsFail);
+        else
+            _socket->_connectState = dnsError;
     }
 
     return false;
@@ -170,9 +571,11 @@ bool SimCommDevice::parseDnsReply()
 
 bool SimCommDevice::parseCiprxget4()
 {
-    if (strncmp(_lineBuffer, "+CIPRXGET: 4,0,", 15) == 0) {
-        int bytesToReceive;
-        sscanf(_lineBuffer + 15, "%d", &bytesToReceive);
+    // +CIPRXGET: 4,<link>,<length>
+    AtTokenizer tokenizer(_lineBuffer + _linePrefixLength);
+    uint32_t link, bytesToReceive;
+    if (_lineReply == atCiprxgetLength && tokenizer.readUint(link) && link == _link
+        && tokenizer.readUint(bytesToReceive)) {
         _bytesToReceive += bytesToReceive;
         return true;
     }
@@ -181,11 +584,37 @@ bool SimCommDevice::parseCiprxget4()
 
 bool SimCommDevice::parseCiprxget2()
 {
-    if (strncmp(_lineBuffer, "+CIPRXGET: 2,0,", 15) == 0) {
-        int bytesToReceive;
-        sscanf(_lineBuffer + 15, "%d", &bytesToReceive);
-        _bytesToReceive -= bytesToReceive;
-        _bytesToRead += bytesToReceive;
+    // +CIPRXGET: 2,<link>,<length>,<remaining>
+    AtTokenizer tokenizer(_lineBuffer + _linePrefixLength);
+    uint32_t link;
+    if (_lineReply == atCiprxgetRead && tokenizer.readUint(link) && link == _link) {
+        uint32_t bytesToRead, bytesRemaining;
+        if (!tokenizer.readUint(bytesToRead))
+            bytesToRead = 0;
+
+        // The modem reports how much is left after this chunk
+        if (_receiveReadAhead && tokenizer.readUint(bytesRemaining))
+            _bytesToReceive = bytesRemaining;
+        else if (bytesToRead < _bytesToReceive)
+            _bytesToReceive -= bytesToRead;
+        else
+            _bytesToReceive = 0;
+
+        // Only grow the chunks if the link keeps up with them
+        if (bytesToRead < _receiveRequested)
+            _receiveRequested = 0;
+
+        // Each read becomes one datagram in the read buffer. The modem
+        // doesn't tell where its datagrams start, so this is best effort.
+        // UdpSocket only hands it out once the payload is complete.
+        if (_socket->_datagram && bytesToRead > 0) {
+            uint8_t header[DATAGRAM_HEADER_SIZE] = { (uint8_t)bytesToRead,
+                (uint8_t)(bytesToRead >> 8) };
+            _socket->_readBuffer.push(header, DATAGRAM_HEADER_SIZE);
+        }
+
+        _bytesToRead += bytesToRead;
+        _receiveBacklog = 0;
         _stateBooleans &= ~LINE_READ;
         return true;
     }
@@ -194,9 +623,10 @@ bool SimCommDevice::parseCiprxget2()
 
 bool SimCommDevice::parseCsq()
 {
-    if (strncmp(_lineBuffer, "+CSQ: ", 6) == 0) {
-        unsigned int rssi;
-        if (sscanf(_lineBuffer + 6, "%u", &rssi) == 1) {
+    if (_lineReply == atCsq) {
+        AtTokenizer tokenizer(_lineBuffer + _linePrefixLength);
+        uint32_t rssi;
+        if (tokenizer.readUint(rssi)) {
             _rssi = rssi;
         }
         return true;
@@ -229,6 +659,22 @@ bool SimCommDevice::handleDisconnect(int8_t nextState)
     return false;
 }
 
+void SimCommDevice::waitWhileIdle()
+{
+    // Marked as waiting first, so an event arriving while checking
+    // the conditions below isn't lost
+    waitForEvent();
+
+    bool pending = _serial.bytesAvailable() || _rssi == UINT8_MAX
+        || (_stateBooleans & (RESET_PENDING | DISCONNECT_PENDING));
+    for (uint8_t i = 0; i < _socketCount && !pending; i++) {
+        pending = socketPending(*_sockets[i]);
+    }
+
+    if (pending)
+        notify();
+}
+
 bool SimCommDevice::handleConnect(int8_t nextState)
 {
     if (_stateBooleans & CONNECT_PENDING) {
@@ -243,11 +689,12 @@ bool SimCommDevice::handleConnect(int8_t nextState)
 
 bool SimCommDevice::sendDnsQuery()
 {
-    if (_serial.spaceAvailable() < strlen(_host) + 20)
+    if (_serial.spaceAvailable() < strlen(_socket->_host) + 20)
         return false;
 
+    commandSent("AT+CDNSGIP=");
     _serial.write((const uint8_t*)"AT+CDNSGIP=\"");
-    _serial.write((const uint8_t*)_host);
+    _serial.write((const uint8_t*)_socket->_host);
     _serial.write((const uint8_t*)_quoteEndStr);
 
     return true;
@@ -255,13 +702,29 @@ bool SimCommDevice::sendDnsQuery()
 
 void SimCommDevice::sendCipstart(const char* variant)
 {
-    char portStr[6];
-    sprintf(portStr, "%d", _port);
+    char portStr[11];
+    AtParser::formatUint(portStr, _socket->_port);
 
+    commandSent("AT+CIP", variant);
     _serial.write((const uint8_t*)"AT+CIP");
     _serial.write((const uint8_t*)variant);
-    _serial.write((const uint8_t*)"=0,\"TCP\",\"");
-    _serial.write((const uint8_t*)_ip);
+    _serial.write((const uint8_t*)"=");
+    if (!(_transparentMode && _transparentSingleLink)) {
+        // Without multiple links the command has no link number
+        writeLink();
+        _serial.write((const uint8_t*)",");
+    }
+
+    if (_socket->_datagram && _datagramPeerInSend) {
+        // The peer is given with every datagram, only bind the local port
+        _serial.write((const uint8_t*)"\"UDP\",,,");
+        _serial.write((const uint8_t*)portStr);
+        _serial.write((const uint8_t*)_lineEndStr);
+        return;
+    }
+
+    _serial.write((const uint8_t*)(_socket->_datagram ? "\"UDP\",\"" : "\"TCP\",\""));
+    _serial.write((const uint8_t*)_socket->_ip);
     _serial.write((const uint8_t*)"\",");
     _serial.write((const uint8_t*)portStr);
     _serial.write((const uint8_t*)_lineEndStr);
@@ -269,88 +732,345 @@ void SimCommDevice::sendCipstart(const char* variant)
 
 bool SimCommDevice::prepareSending()
 {
-    if (_serial.spaceAvailable() < 22)
+    bool sendPeer = _socket->_datagram && _datagramPeerInSend;
+    if (_serial.spaceAvailable() < MIN_SPACE_AVAILABLE + (sendPeer ? sizeof(_socket->_ip) + 8 : 0))
         return false;
 
-    _bytesToWrite = _writeBuffer.bytesAvailable();
-    if (_bytesToWrite > _serial.spaceAvailable() - MIN_SPACE_AVAILABLE) {
-        _bytesToWrite = _serial.spaceAvailable() - MIN_SPACE_AVAILABLE;
+    if (_socket->_datagram) {
+        // Exactly one datagram, which the modem can't split. The header
+        // stays in the buffer until the payload goes out, so a reset
+        // before the prompt doesn't break the framing.
+        Size spanSize;
+        uint8_t low = _socket->_writeBuffer.read();
+        uint8_t high = *_socket->_writeBuffer.linearReadSpan(spanSize, 1);
+        _bytesToWrite = low | (Size)high << 8;
+        if (_bytesToWrite > _maxSendLength) {
+            _socket->_writeBuffer.discard(DATAGRAM_HEADER_SIZE + _bytesToWrite);
+            _bytesToWrite = 0;
+            return false;
+        }
+        _datagramHeaderPending = true;
+    } else {
+        // The payload is streamed into the serial after the prompt,
+        // so the chunk size is only limited by the modem
+        _bytesToWrite = _socket->_writeBuffer.bytesAvailable();
+        if (_bytesToWrite > _maxSendLength) {
+            _bytesToWrite = _maxSendLength;
+        }
     }
 
-    char sizeStr[6];
-    sprintf(sizeStr, "%u", (unsigned int)_bytesToWrite);
+    char sizeStr[11];
+    AtParser::formatUint(sizeStr, _bytesToWrite);
 
-    _serial.write((const uint8_t*)"AT+CIPSEND=0,");
+    commandSent("AT+CIPSEND=");
+    _linkStats.sendRoundTrips++;
+    _serial.write((const uint8_t*)"AT+CIPSEND=");
+    writeLink();
+    _serial.write((const uint8_t*)",");
     _serial.write((const uint8_t*)sizeStr);
+    if (sendPeer) {
+        char portStr[11];
+        AtParser::formatUint(portStr, _socket->_port);
+        _serial.write((const uint8_t*)",\"");
+        _serial.write((const uint8_t*)_socket->_ip);
+        _serial.write((const uint8_t*)"\",");
+        _serial.write((const uint8_t*)portStr);
+    }
     _serial.write((const uint8_t*)_lineEndStr);
 
     _waitForReply = ">";
+    _socket->_connectState = IPCommDevice::transmitting;
 
     return true;
 }
 
-void SimCommDevice::sendData()
+bool SimCommDevice::sendData()
 {
-    while (_bytesToWrite--) {
-        _serial.write(_writeBuffer.pull());
+    if (_datagramHeaderPending) {
+        _socket->_writeBuffer.discard(DATAGRAM_HEADER_SIZE);
+        _datagramHeaderPending = false;
+    }
+
+    // Hand the payload to the serial in at most two contiguous blocks.
+    // If the serial buffer fills up, continue on the next call.
+    while (_bytesToWrite) {
+        Size size;
+        const uint8_t* span = _socket->_writeBuffer.linearReadSpan(size);
+        if (size > _bytesToWrite)
+            size = _bytesToWrite;
+
+        Size written = _serial.write(span, size);
+        _socket->_writeBuffer.commitRead(written);
+        _bytesToWrite -= written;
+        _linkStats.bytesSent += written;
+
+        if (written == 0 || written < size)
+            break;
     }
+
+    return _bytesToWrite == 0;
+}
+
+void SimCommDevice::abortSending()
+{
+    // A datagram that the modem only got part of is lost, drop the rest
+    // of it. One that wasn't started yet is sent again after the reset.
+    if (_socket->_datagram && !_datagramHeaderPending)
+        _socket->_writeBuffer.discard(_bytesToWrite);
+
+    _datagramHeaderPending = false;
+    _bytesToWrite = 0;
 }
 
 bool SimCommDevice::sendCiprxget2()
 {
-    if (_serial.spaceAvailable() > 8 && _readBuffer.spaceAvailable() > 0) {
-        Size bytesToReceive = _serial.spaceAvailable() - 8;
+    CircularBuffer<uint8_t, E_NETWORK_BUFFERSIZE>& readBuffer = _socket->_readBuffer;
+    if (_serial.spaceAvailable() <= MIN_SPACE_AVAILABLE)
+        return false;
+
+    Size bytesToReceive = _receiveChunkSize;
+    Size space = readBuffer.spaceAvailable();
+    bool blocked = space == 0;
+
+    if (_socket->_datagram) {
+        // Read as much as the modem holds, up to one datagram's worth,
+        // with space for its length
+        bytesToReceive = _maxReceiveLength;
         if (bytesToReceive > _bytesToReceive)
             bytesToReceive = _bytesToReceive;
-        if (bytesToReceive > _readBuffer.spaceAvailable())
-            bytesToReceive = _readBuffer.spaceAvailable();
-
-        const char str[] = "AT+CIPRXGET=2,0,";
-        char sizeStr[6];
-        sprintf(sizeStr, "%u", (unsigned int)bytesToReceive);
-        _serial.write((const uint8_t*)str, sizeof(str) - 1);
-        _serial.write((const uint8_t*)sizeStr);
-        _serial.write((const uint8_t*)_lineEndStr);
-        return true;
-    } else {
+        blocked = bytesToReceive + DATAGRAM_HEADER_SIZE > space && !readBuffer.isEmpty();
+        space -= DATAGRAM_HEADER_SIZE;
+    }
+
+    if (blocked) {
+        // Serve the other sockets until the application made room
+        _socket->_stateBooleans |= RECEIVE_BLOCKED;
+        yieldReceiving();
         return false;
     }
+
+    if (bytesToReceive > _bytesToReceive)
+        bytesToReceive = _bytesToReceive;
+    if (bytesToReceive > space)
+        bytesToReceive = space;
+    _receiveRequested = bytesToReceive;
+
+    const char str[] = "AT+CIPRXGET=2,";
+    char sizeStr[11];
+    AtParser::formatUint(sizeStr, bytesToReceive);
+    commandSent(str);
+    _linkStats.receiveRoundTrips++;
+    _serial.write((const uint8_t*)str, sizeof(str) - 1);
+    writeLink();
+    _serial.write((const uint8_t*)",");
+    _serial.write((const uint8_t*)sizeStr);
+    _serial.write((const uint8_t*)_lineEndStr);
+    return true;
 }
 
-void SimCommDevice::checkConnectionState(const char* closeVariant)
+bool SimCommDevice::receive()
 {
-    if (strncmp(_lineBuffer, "+CIPRXGET: 1,0", 14) == 0) {
-        _stateBooleans |= DATA_PENDING;
-    } else if (strncmp(_lineBuffer, closeVariant, strlen(closeVariant)) == 0) {
-        _waitForReply = NULL;
-        _stateBooleans &= ~IP_CONNECTED;
+    // Remember how far the UART got ahead of us for chunk sizing
+    Size backlog = _serial.bytesAvailable();
+    if (backlog > _receiveBacklog)
+        _receiveBacklog = backlog;
+
+    // Copy the payload straight from the serial into the network buffer
+    // as it arrives, in at most two contiguous blocks per call
+    while (_bytesToRead) {
+        Size size;
+        uint8_t* span = _socket->_readBuffer.linearWriteSpan(size);
+        if (size > _bytesToRead)
+            size = _bytesToRead;
+
+        Size read = _serial.read(span, size);
+        if (read == 0)
+            break;
+
+        _socket->_readBuffer.commitWrite(read);
+        _bytesToRead -= read;
+        _linkStats.bytesReceived += read;
     }
+
+    if (_bytesToRead == 0) {
+        _stateBooleans |= LINE_READ;
+        adaptReceiveChunkSize();
+        return true;
+    }
+
+    return false;
 }
 
-bool SimCommDevice::receive()
+void SimCommDevice::adaptReceiveChunkSize()
 {
-    if (_serial.bytesAvailable() >= _bytesToRead) {
-        while (_bytesToRead) {
-            _readBuffer.push(_serial.read());
-            _bytesToRead--;
-        }
-        _stateBooleans |= LINE_READ;
+    // Shrink the chunks when the UART delivers data faster than they are
+    // consumed, grow them while the link fills every chunk we ask for and
+    // the serial buffer has plenty of headroom
+    Size bufferSize = _serial.bufferSize();
+    if (_receiveBacklog > bufferSize / 4 * 3) {
+        _receiveChunkSize /= 2;
+        if (_receiveChunkSize < MIN_RECEIVE_CHUNK)
+            _receiveChunkSize = MIN_RECEIVE_CHUNK;
+    } else if (_receiveBacklog < bufferSize / 2 && _receiveRequested > 0
+        && _receiveRequested == _receiveChunkSize) {
+        _receiveChunkSize *= 2;
+        if (_receiveChunkSize > _maxReceiveLength)
+            _receiveChunkSize = _maxReceiveLength;
+    }
+}
 
-        return true;
-    } else {
-        return false;
+void SimCommDevice::enterDataMode()
+{
+    // From here on, everything on the serial is payload
+    _stateBooleans &= ~LINE_READ;
+    _closedMatch = 0;
+    setDelay(0);
+}
+
+bool SimCommDevice::transferTransparent()
+{
+    // In transparent mode the serial carries the payload itself.
+    // Returns true if any data moved in either direction.
+    bool moved = false;
+
+    while (!_writeBuffer.isEmpty()) {
+        Size size;
+        const uint8_t* span = _writeBuffer.linearReadSpan(size);
+        Size written = _serial.write(span, size);
+        _writeBuffer.commitRead(written);
+        _linkStats.bytesSent += written;
+        if (written > 0)
+            moved = true;
+        if (written < size)
+            break;
     }
+
+    while ((_stateBooleans & IP_CONNECTED) && _serial.bytesAvailable()) {
+        Size size;
+        uint8_t* span = _readBuffer.linearWriteSpan(size);
+        if (size == 0)
+            break;
+
+        Size read = _serial.read(span, size);
+        if (read == 0)
+            break;
+
+        Size payload = scanClosed(span, read);
+        _readBuffer.commitWrite(payload);
+        _linkStats.bytesReceived += payload;
+        moved = true;
+    }
+
+    return moved;
+}
+
+Size SimCommDevice::scanClosed(const uint8_t* data, Size size)
+{
+    // The modem reports a closed connection with a CLOSED line and returns
+    // to command mode. Returns the number of bytes that are payload.
+    static const char closed[] = "\r\nCLOSED\r\n";
+    const Size length = sizeof(closed) - 1;
+
+    for (Size i = 0; i < size; i++) {
+        if (data[i] == closed[_closedMatch])
+            _closedMatch++;
+        else
+            _closedMatch = data[i] == closed[0] ? 1 : 0;
+
+        if (_closedMatch == length) {
+            _closedMatch = 0;
+            _stateBooleans &= ~IP_CONNECTED;
+
+            // Parts of the notice read with the previous block were
+            // already taken as payload
+            return i + 1 >= length ? i + 1 - length : 0;
+        }
+    }
+
+    return size;
+}
+
+bool SimCommDevice::escapeRequested() const
+{
+    return _rssi == UINT8_MAX || (_stateBooleans & DISCONNECT_PENDING);
+}
+
+void SimCommDevice::sendEscape()
+{
+    // The modem answers with OK after another guard time without data
+    commandSent("+++");
+    _serial.write((const uint8_t*)"+++");
+    _stateBooleans |= LINE_READ;
+    _lbFill = 0;
+    _waitForReply = _okStr;
+    setDelay(10);
 }
 
 void SimCommDevice::sendCommand(const char* cmd)
 {
+    commandSent(cmd);
     _serial.write((const uint8_t*)cmd);
     _serial.write((const uint8_t*)_lineEndStr);
 }
 
+bool SimCommDevice::addUrcHandler(AtReply urc, UrcHandler handler, void* context)
+{
+    if (!AtParser::isUnsolicited(urc))
+        return false;
+
+    for (Size i = 0; i < E_URC_HANDLERS; i++) {
+        if (_urcHandlers[i].handler == NULL) {
+            _urcHandlers[i].urc = urc;
+            _urcHandlers[i].handler = handler;
+            _urcHandlers[i].context = context;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void SimCommDevice::removeUrcHandler(AtReply urc, UrcHandler handler)
+{
+    for (Size i = 0; i < E_URC_HANDLERS; i++) {
+        if (_urcHandlers[i].urc == urc && _urcHandlers[i].handler == handler)
+            _urcHandlers[i].handler = NULL;
+    }
+}
+
+void SimCommDevice::setSendPipelining(bool enable)
+{
+    _sendPipelining = enable;
+}
+
+void SimCommDevice::setReceiveReadAhead(bool enable)
+{
+    _receiveReadAhead = enable;
+}
+
+void SimCommDevice::setTransparentMode(bool enable)
+{
+    _transparentMode = enable;
+}
+
+void SimCommDevice::setDnsCacheTtl(E_TICK_TYPE ttl)
+{
+    _dnsCacheTtl = ttl;
+    if (ttl == 0)
+        flushDnsCache();
+}
+
+void SimCommDevice::flushDnsCache()
+{
+    for (Size i = 0; i < E_DNS_CACHE_SIZE; i++) {
+        _dnsCache[i].host[0] = '\0';
+    }
+}
+
 void SimCommDevice::requestRSSI()
 {
     _rssi = UINT8_MAX;
+    notify();
 }
 
 uint8_t SimCommDevice::getRSSI()
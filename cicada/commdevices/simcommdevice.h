@@ -24,7 +24,9 @@
 #ifndef SIMCOMMDEVICE_H
 #define SIMCOMMDEVICE_H
 
+#include "cicada/commdevices/atparser.h"
 #include "cicada/commdevices/ipcommdevice.h"
+#include "cicada/commdevices/modemtrace.h"
 
 #define LINE_MAX_LENGTH 60
 
@@ -33,6 +35,19 @@ namespace Cicada {
 class SimCommDevice : public IPCommDevice
 {
   public:
+    /*!
+     * Handler for unsolicited result codes.
+     * \param urc Type of the unsolicited result code
+     * \param line The complete line, only valid during the call
+     * \param context Context pointer given to addUrcHandler()
+     */
+    typedef void (*UrcHandler)(AtReply urc, const char* line, void* context);
+
+    /*!
+     * \param serial Serial device of the modem. The comm device sets itself
+     * as its receive task (see IBufferedSerial::setReceiveTask()), so it can
+     * wait for an event instead of polling while the connection is idle.
+     */
     SimCommDevice(IBufferedSerial& serial);
     virtual ~SimCommDevice() {}
 
@@ -99,41 +114,253 @@ class SimCommDevice : public IPCommDevice
      */
     uint8_t getRSSI();
 
+    /*!
+     * Enables or disables pipelined sending. When enabled, the next
+     * AT+CIPSEND is issued right after the payload of the previous one,
+     * without waiting for its acknowledgement. This saves a round trip per
+     * chunk on high latency links. The transfer completes once every chunk
+     * is acknowledged. Only the SIM7x00 driver pipelines, the SIM800 is not
+     * known to accept AT+CIPSEND before the previous SEND OK and ignores
+     * this setting. Disabled by default.
+     *
+     * \param enable true to enable pipelined sending
+     */
+    void setSendPipelining(bool enable);
+
+    /*!
+     * Enables or disables read-ahead for received data. When enabled, the
+     * remaining length reported in each +CIPRXGET: 2 reply is used to
+     * request the next chunk right away, and AT+CIPRXGET=4 is not sent
+     * anymore. Disabled by default.
+     *
+     * \param enable true to enable read-ahead
+     */
+    void setReceiveReadAhead(bool enable);
+
+    /*!
+     * Enables or disables transparent mode, takes effect on the next
+     * connect. In transparent mode the modem passes the payload of the
+     * connection through the serial line unchanged, without AT+CIPSEND and
+     * AT+CIPRXGET framing. Only this device's connection is served,
+     * attached sockets stay unconnected. Requesting the RSSI and
+     * disconnecting need an escape to command mode with "+++", which is
+     * only sent after E_ESCAPE_GUARD_TIME without data in either
+     * direction. Disabled by default.
+     *
+     * \param enable true to enable transparent mode
+     */
+    void setTransparentMode(bool enable);
+
+    /*!
+     * Sets how long resolved host names are kept. Connecting to a host
+     * which was resolved less than ttl ticks ago uses the cached address
+     * instead of asking the modem with AT+CDNSGIP, which also holds after
+     * a modem reset. Hosts given as dotted-quad address are never looked
+     * up. Defaults to E_DNS_CACHE_TTL.
+     *
+     * \param ttl Time to keep an address in ticks, 0 disables the cache
+     */
+    void setDnsCacheTtl(E_TICK_TYPE ttl);
+
+    /*!
+     * Forgets all cached host addresses.
+     */
+    void flushDnsCache();
+
+    /*!
+     * Attaches an additional socket, which gets the next free link of the
+     * modem. The socket can be connected and used like this device, but
+     * only while this device is connected. Sockets with pending work are
+     * served in turn, one AT command transaction at a time. Disconnecting
+     * this device closes all sockets.
+     *
+     * \param socket Socket to attach, needs to live as long as the device
+     * \return false if all links are in use
+     */
+    bool attachSocket(IPSocket& socket);
+
+    /*!
+     * Registers a handler for an unsolicited result code (URC), such as
+     * +CIPRXGET: 1, +IPCLOSE, +PDP: DEACT or RDY. Handlers are called as
+     * soon as the line is read, independent of the command currently
+     * executed. The driver handles these codes itself as well, the
+     * handlers are only informed.
+     *
+     * \param urc Unsolicited result code to listen for
+     * \param handler Function to call
+     * \param context Pointer passed to the handler
+     * \return false if urc is not an unsolicited result code or all
+     * E_URC_HANDLERS slots are in use
+     */
+    bool addUrcHandler(AtReply urc, UrcHandler handler, void* context = NULL);
+
+    /*!
+     * Removes a handler registered with addUrcHandler().
+     *
+     * \param urc Unsolicited result code the handler listens for
+     * \param handler Function to remove
+     */
+    void removeUrcHandler(AtReply urc, UrcHandler handler);
+
+#ifdef CICADA_TRACE
+    /*!
+     * Binary trace of the driver's state transitions, the AT commands
+     * sent and the replies read, to be dumped with ModemTrace::dump().
+     * Only available when built with CICADA_TRACE.
+     */
+    inline ModemTrace& trace()
+    {
+        return _trace;
+    }
+#endif
+
   protected:
+    enum SocketAction {
+        socketIdle,
+        socketConnect,
+        socketDisconnect,
+        socketSend,
+        socketReceive
+    };
+
+    struct DnsCacheEntry
+    {
+        char host[E_DNS_CACHE_HOST_LENGTH];
+        char ip[16];
+        E_TICK_TYPE time;
+    };
+
+    struct UrcSubscription
+    {
+        AtReply urc;
+        UrcHandler handler;
+        void* context;
+    };
+
     bool fillLineBuffer();
+    bool dispatchUrc();
+    bool lineUint(uint8_t field, uint32_t& value) const;
+    bool lineLink(uint32_t& link) const;
+    SocketAction nextSocketAction();
+    bool selectSocket();
+    bool socketPending(const IPSocket& socket) const;
+    bool receivePending(const IPSocket& socket) const;
+    bool othersPending() const;
+    bool continueSending() const;
+    bool socketLookupFailed() const;
+    void setSocketConnected();
+    void endTransfer();
+    void yieldReceiving();
+    void closeSocket(ConnectState state);
+    void resetSockets();
+    void closeSockets();
+    const char* linkReply(const char* prefix, const char* suffix);
+    void writeLink();
+    void sendLinkCommand(const char* cmd);
     void logStates(int8_t sendState, int8_t replyState);
+    bool resolveCached();
+    void cacheHost();
+    void uncacheHost();
     bool parseDnsReply();
     bool parseCiprxget4();
     bool parseCiprxget2();
     bool parseCsq();
-    void checkConnectionState(const char* closeVariant);
     void flushReadBuffer();
     bool handleDisconnect(int8_t nextState);
+    void waitWhileIdle();
     bool handleConnect(int8_t nextState);
     bool sendDnsQuery();
     void sendCipstart(const char* openVariant);
     bool prepareSending();
-    void sendData();
+    bool sendData();
+    void abortSending();
     bool sendCiprxget2();
     bool receive();
+    void adaptReceiveChunkSize();
+    bool transferTransparent();
+    Size scanClosed(const uint8_t* data, Size size);
+    void enterDataMode();
+    bool escapeRequested() const;
+    void sendEscape();
     void sendCommand(const char* cmd);
 
+    // Statistics and trace hooks, tracing is a no-op without CICADA_TRACE
+    inline void traceStates()
+    {
+#ifdef CICADA_TRACE
+        if (_sendState != _tracedSendState || _replyState != _tracedReplyState) {
+            _tracedSendState = _sendState;
+            _tracedReplyState = _replyState;
+            _trace.record(lastRun(), traceEventState, _sendState, (uint8_t)_replyState);
+        }
+#endif
+    }
+
+    inline void commandSent(const char* cmd, const char* suffix = NULL)
+    {
+        startCommandRtt();
+#ifdef CICADA_TRACE
+        traceStates();
+        _trace.record(lastRun(), traceEventCommand, 0, ModemTrace::commandId(cmd, suffix));
+#else
+        (void)cmd;
+        (void)suffix;
+#endif
+    }
+
+    inline void traceReply()
+    {
+#ifdef CICADA_TRACE
+        _trace.record(lastRun(), traceEventReply, _lineReply);
+#endif
+    }
+
     IBufferedSerial& _serial;
     const char* _apn;
 
     char _lineBuffer[LINE_MAX_LENGTH + 1];
     uint8_t _lbFill;
+    AtReply _lineReply;
+    Size _linePrefixLength;
 
-    char _ip[16];
+    IPSocket* _sockets[E_MAX_SOCKETS];
+    IPSocket* _socket;
+    uint8_t _link;
+    uint8_t _socketCount;
+    uint8_t _maxSockets;
+    char _linkReply[20];
 
     int8_t _sendState;
     int8_t _replyState;
     Size _bytesToWrite;
     Size _bytesToReceive;
     Size _bytesToRead;
+    Size _maxSendLength;
+    Size _maxReceiveLength;
+    Size _receiveChunkSize;
+    Size _receiveRequested;
+    Size _receiveBacklog;
+    bool _datagramPeerInSend;
+    bool _datagramHeaderPending;
+    bool _sendPipelining;
+    bool _receiveReadAhead;
+    bool _transparentMode;
+    bool _transparentSingleLink;
+    uint8_t _closedMatch;
 
     uint8_t _rssi;
 
+    UrcSubscription _urcHandlers[E_URC_HANDLERS];
+
+    DnsCacheEntry _dnsCache[E_DNS_CACHE_SIZE];
+    E_TICK_TYPE _dnsCacheTtl;
+
+#ifdef CICADA_TRACE
+    ModemTrace _trace;
+    int8_t _tracedSendState;
+    int8_t _tracedReplyState;
+#endif
+
     static const char* _okStr;
     static const char* _lineEndStr;
     static const char* _quoteEndStr;
@@ -0,0 +1,98 @@
+/*
+ * E-Lib
+ * Copyright (C) 2019 EnAccess
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "cicada/commdevices/udpsocket.h"
+
+using namespace Cicada;
+
+UdpSocket::UdpSocket()
+{
+    _datagram = true;
+}
+
+Size UdpSocket::sendTo(const uint8_t* data, Size size)
+{
+    if (_connectState != connected || size == 0 || size > spaceAvailable())
+        return 0;
+
+    uint8_t header[DATAGRAM_HEADER_SIZE] = { (uint8_t)size, (uint8_t)(size >> 8) };
+    _writeBuffer.push(header, DATAGRAM_HEADER_SIZE);
+    _writeBuffer.push(data, size);
+    notifyDevice();
+
+    return size;
+}
+
+Size UdpSocket::recvFrom(uint8_t* data, Size maxSize)
+{
+    Size size = bytesAvailable();
+    if (size == 0)
+        return 0;
+
+    _readBuffer.discard(DATAGRAM_HEADER_SIZE);
+    Size copied = _readBuffer.pull(data, size < maxSize ? size : maxSize);
+    _readBuffer.discard(size - copied);
+    notifyDevice();
+
+    return copied;
+}
+
+Size UdpSocket::bytesAvailable() const
+{
+    Size available = _readBuffer.bytesAvailable();
+    if (available < DATAGRAM_HEADER_SIZE)
+        return 0;
+
+    // The header may wrap around the end of the buffer
+    Size spanSize;
+    uint8_t low = _readBuffer.read();
+    uint8_t high = *_readBuffer.linearReadSpan(spanSize, 1);
+    Size size = low | (Size)high << 8;
+
+    // The header is written before the payload, which may arrive over
+    // several runs of the comm device
+    if (available < DATAGRAM_HEADER_SIZE + size)
+        return 0;
+
+    return size;
+}
+
+Size UdpSocket::spaceAvailable() const
+{
+    Size space = _writeBuffer.spaceAvailable();
+    if (_connectState != connected || space <= DATAGRAM_HEADER_SIZE)
+        return 0;
+
+    return space - DATAGRAM_HEADER_SIZE;
+}
+
+Size UdpSocket::read(uint8_t* data, Size maxSize)
+{
+    return recvFrom(data, maxSize);
+}
+
+Size UdpSocket::write(const uint8_t* data, Size size)
+{
+    return sendTo(data, size);
+}
@@ -0,0 +1,92 @@
+/*
+ * E-Lib
+ * Copyright (C) 2019 EnAccess
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef EUDPSOCKET_H
+#define EUDPSOCKET_H
+
+#include "cicada/commdevices/ipcommdevice.h"
+
+namespace Cicada {
+
+/*!
+ * \class UdpSocket
+ *
+ * Datagram socket for modems with UDP support. It is attached to a comm
+ * device with SimCommDevice::attachSocket() and connected like any other
+ * socket. Datagrams are exchanged with the peer set by setHostPort().
+ * Each datagram is sent with a single AT+CIPSEND, so boundaries are
+ * kept when sending. When receiving they are only kept as far as the
+ * modem allows: every AT+CIPRXGET read ends up as one datagram, so
+ * datagrams queued in the modem may be merged, and a datagram larger
+ * than the modem's read limit or the read buffer is split.
+ */
+class UdpSocket : public IPSocket
+{
+  public:
+    UdpSocket();
+    virtual ~UdpSocket() {}
+
+    /*!
+     * Queues a datagram for sending. Datagrams are never split, so it is
+     * either queued completely or not at all.
+     * \param data Payload of the datagram
+     * \param size Size of the payload, must not exceed the modem's limit
+     * \return size if the datagram was queued, 0 if it doesn't fit
+     * or the socket is not connected
+     */
+    Size sendTo(const uint8_t* data, Size size);
+
+    /*!
+     * Reads the next received datagram, as far as the modem kept its
+     * boundaries. If it is larger than maxSize, the rest of it is discarded.
+     * \param data Buffer to copy the payload into
+     * \param maxSize Size of the buffer
+     * \return Number of bytes copied to data, 0 if no datagram is available
+     */
+    Size recvFrom(uint8_t* data, Size maxSize);
+
+    /*!
+     * \return Size of the next datagram to read, 0 if there is none or
+     * its payload is still being received from the modem
+     */
+    virtual Size bytesAvailable() const;
+
+    /*!
+     * \return Size of the largest datagram which can be queued
+     */
+    virtual Size spaceAvailable() const;
+
+    /*!
+     * Same as recvFrom().
+     */
+    virtual Size read(uint8_t* data, Size maxSize);
+
+    /*!
+     * Same as sendTo().
+     */
+    virtual Size write(const uint8_t* data, Size size);
+};
+}
+
+#endif
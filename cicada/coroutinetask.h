@@ -0,0 +1,419 @@
+/*
+ * E-Lib
+ * Copyright (C) 2019 EnAccess
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+/*!
+ * \file coroutinetask.h
+ * Coroutine based alternative to the E_BEGIN_TASK/E_REENTER macros.
+ * Requires C++20, the file is empty for older language versions.
+ */
+
+#ifndef ECOROUTINETASK_H
+#define ECOROUTINETASK_H
+
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+
+#include "cicada/defines.h"
+#include "cicada/ibufferedserial.h"
+#include "cicada/task.h"
+#include "cicada/types.h"
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+
+namespace Cicada {
+
+/*!
+ * \class CoroutineArena
+ *
+ * Fixed pool for coroutine frames, so coroutines never allocate from
+ * the heap. There are E_COROUTINE_FRAMES frames of E_COROUTINE_FRAME_SIZE
+ * bytes each. Only use coroutines from the scheduler's context, the
+ * arena is not thread safe.
+ */
+class CoroutineArena
+{
+  public:
+    /*!
+     * \param size Size of the coroutine frame
+     * \return Pointer to a free frame, NULL if size is too big or
+     * all frames are in use
+     */
+    static void* allocate(std::size_t size) noexcept
+    {
+        if (size > E_COROUTINE_FRAME_SIZE)
+            return NULL;
+
+        for (unsigned int i = 0; i < E_COROUTINE_FRAMES; i++) {
+            if (!(_used & (1u << i))) {
+                _used |= 1u << i;
+                return _frames[i].data;
+            }
+        }
+
+        return NULL;
+    }
+
+    /*!
+     * Returns a frame to the arena.
+     * \param ptr Frame returned by allocate()
+     */
+    static void release(void* ptr) noexcept
+    {
+        std::size_t i = (Frame*)ptr - _frames;
+        _used &= ~(1u << i);
+    }
+
+    /*!
+     * \return Number of frames in use
+     */
+    static unsigned int framesInUse()
+    {
+        return __builtin_popcount(_used);
+    }
+
+  private:
+    static_assert(E_COROUTINE_FRAMES <= 32, "Arena supports up to 32 frames");
+
+    struct Frame
+    {
+        alignas(std::max_align_t) uint8_t data[E_COROUTINE_FRAME_SIZE];
+    };
+
+    static inline Frame _frames[E_COROUTINE_FRAMES];
+    static inline uint32_t _used = 0;
+};
+
+/*!
+ * \class Coroutine
+ *
+ * Return type of CoroutineTask::body(). Owns the coroutine frame and
+ * destroys it when going out of scope.
+ */
+class Coroutine
+{
+  public:
+    struct promise_type
+    {
+        Coroutine get_return_object()
+        {
+            return Coroutine(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        static Coroutine get_return_object_on_allocation_failure()
+        {
+            return Coroutine();
+        }
+
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_always final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void() {}
+
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+
+        static void* operator new(std::size_t size) noexcept
+        {
+            return CoroutineArena::allocate(size);
+        }
+
+        static void operator delete(void* ptr) noexcept
+        {
+            CoroutineArena::release(ptr);
+        }
+    };
+
+    Coroutine() : _handle(NULL) {}
+
+    Coroutine(Coroutine&& other) noexcept : _handle(other._handle)
+    {
+        other._handle = NULL;
+    }
+
+    Coroutine& operator=(Coroutine&& other) noexcept
+    {
+        if (this != &other) {
+            if (_handle)
+                _handle.destroy();
+            _handle = other._handle;
+            other._handle = NULL;
+        }
+        return *this;
+    }
+
+    ~Coroutine()
+    {
+        if (_handle)
+            _handle.destroy();
+    }
+
+    /*!
+     * \return true if the coroutine frame could be allocated
+     */
+    inline bool isValid() const
+    {
+        return (bool)_handle;
+    }
+
+    /*!
+     * \return true if the coroutine has finished
+     */
+    inline bool isDone() const
+    {
+        return _handle.done();
+    }
+
+    /*!
+     * Continues the coroutine up to the next co_await.
+     */
+    inline void resume()
+    {
+        _handle.resume();
+    }
+
+  private:
+    explicit Coroutine(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+
+    Coroutine(const Coroutine&) = delete;
+    Coroutine& operator=(const Coroutine&) = delete;
+
+    std::coroutine_handle<promise_type> _handle;
+};
+
+/*!
+ * \class CoroutineTask
+ *
+ * Task which runs a C++20 coroutine instead of a switch/case state
+ * machine. Unlike the E_REENTER macros, the resume point is stored per
+ * instance and local variables survive a co_await, so several instances
+ * of the same class can run independently. The coroutine frame comes
+ * from the CoroutineArena. If no frame is available, the task doesn't run.
+ *
+ * To create a task, inherit from this class and implement body().
+ * It is started on the first run() and driven by the Scheduler like
+ * any other task. When body() returns, the task waits forever.
+ *
+ * ```
+ * virtual Coroutine body()
+ * {
+ *     char buffer[64];
+ *     for (;;) {
+ *         co_await delay(1000);
+ *         _serial.write((const uint8_t*)"AT\r\n");
+ *         Size size = co_await line(_serial, buffer, sizeof(buffer));
+ *         co_await until([this] { return _connected; });
+ *     }
+ * }
+ * ```
+ */
+class CoroutineTask : public Task
+{
+  public:
+    CoroutineTask(uint16_t initialDelay = 0, uint8_t priority = E_DEFAULT_TASK_PRIORITY) :
+        Task(initialDelay, priority),
+        _started(false),
+        _check(NULL),
+        _checkContext(NULL)
+    {}
+
+    /*!
+     * Resumes the coroutine. Starts it on the first call.
+     */
+    virtual void run() final
+    {
+        if (!_started) {
+            _started = true;
+            _coroutine = body();
+        }
+
+        if (!_coroutine.isValid()) {
+            waitForEvent();
+            return;
+        }
+
+        if (_check) {
+            if (!_check(_checkContext))
+                return;
+            _check = NULL;
+        }
+
+        _coroutine.resume();
+
+        if (_coroutine.isDone()) {
+            _coroutine = Coroutine();
+            waitForEvent();
+        }
+    }
+
+    using Task::delay;
+
+  protected:
+    /*!
+     * The coroutine to run, implemented by the actual task.
+     */
+    virtual Coroutine body() = 0;
+
+    class DelayAwaiter
+    {
+      public:
+        DelayAwaiter(CoroutineTask& task, uint16_t ms) : _task(task), _ms(ms) {}
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<>) noexcept
+        {
+            _task.setDelay(_ms);
+        }
+
+        void await_resume() const noexcept {}
+
+      private:
+        CoroutineTask& _task;
+        uint16_t _ms;
+    };
+
+    template <typename Condition> class UntilAwaiter
+    {
+      public:
+        UntilAwaiter(CoroutineTask& task, Condition cond) : _task(task), _cond(cond) {}
+
+        bool await_ready()
+        {
+            return _cond();
+        }
+
+        void await_suspend(std::coroutine_handle<>)
+        {
+            _task.setDelay(0);
+            _task._check = &check;
+            _task._checkContext = this;
+        }
+
+        void await_resume() const noexcept {}
+
+      private:
+        static bool check(void* self)
+        {
+            return static_cast<UntilAwaiter*>(self)->_cond();
+        }
+
+        CoroutineTask& _task;
+        Condition _cond;
+    };
+
+    class LineAwaiter
+    {
+      public:
+        LineAwaiter(CoroutineTask& task, IBufferedSerial& serial, char* buffer, Size size) :
+            _task(task),
+            _serial(serial),
+            _buffer(buffer),
+            _size(size)
+        {}
+
+        bool await_ready()
+        {
+            return _serial.canReadLine();
+        }
+
+        void await_suspend(std::coroutine_handle<>)
+        {
+            _task.setDelay(0);
+            _task._check = &check;
+            _task._checkContext = this;
+        }
+
+        Size await_resume()
+        {
+            return _serial.readLine((uint8_t*)_buffer, _size);
+        }
+
+      private:
+        static bool check(void* self)
+        {
+            return static_cast<LineAwaiter*>(self)->_serial.canReadLine();
+        }
+
+        CoroutineTask& _task;
+        IBufferedSerial& _serial;
+        char* _buffer;
+        Size _size;
+    };
+
+    /*!
+     * `co_await delay(ms)` suspends the coroutine for at least ms ticks.
+     * \param ms Minimum delay
+     */
+    inline DelayAwaiter delay(uint16_t ms)
+    {
+        return DelayAwaiter(*this, ms);
+    }
+
+    /*!
+     * `co_await until(cond)` suspends the coroutine until cond() returns
+     * true. The condition is checked every time the scheduler runs the task.
+     * \param cond Callable returning bool, usually a lambda
+     */
+    template <typename Condition> inline UntilAwaiter<Condition> until(Condition cond)
+    {
+        return UntilAwaiter<Condition>(*this, cond);
+    }
+
+    /*!
+     * `co_await line(serial, buffer, size)` suspends the coroutine until
+     * a complete line can be read from serial, and returns the result of
+     * IBufferedSerial::readLine().
+     * \param serial Serial device to read from
+     * \param buffer Buffer for the line
+     * \param size Size of the buffer
+     */
+    inline LineAwaiter line(IBufferedSerial& serial, char* buffer, Size size)
+    {
+        return LineAwaiter(*this, serial, buffer, size);
+    }
+
+  private:
+    Coroutine _coroutine;
+    bool _started;
+    bool (*_check)(void*);
+    void* _checkContext;
+};
+}
+
+#endif
+
+#endif
@@ -32,10 +32,16 @@
 #define E_TICK_TYPE uint32_t
 #endif
 
+#define E_TICK_MAX ((E_TICK_TYPE)~(E_TICK_TYPE)0)
+
 #ifndef E_SIZE_TYPE
 #define E_SIZE_TYPE uint64_t
 #endif
 
+#ifndef E_RING_INDEX_TYPE
+#define E_RING_INDEX_TYPE uint32_t
+#endif
+
 #ifndef E_SERIAL_BUFFERSIZE
 #define E_SERIAL_BUFFERSIZE 1504
 #endif
@@ -44,6 +50,70 @@
 #define E_NETWORK_BUFFERSIZE 1200
 #endif
 
+#ifndef E_MAX_SOCKETS
+#define E_MAX_SOCKETS 4
+#endif
+
+#ifndef E_URC_HANDLERS
+#define E_URC_HANDLERS 4
+#endif
+
+#ifndef E_DNS_CACHE_SIZE
+#define E_DNS_CACHE_SIZE 4
+#endif
+
+#ifndef E_DNS_CACHE_HOST_LENGTH
+#define E_DNS_CACHE_HOST_LENGTH 32
+#endif
+
+#ifndef E_DNS_CACHE_TTL
+#define E_DNS_CACHE_TTL 600000
+#endif
+
+#ifndef E_TRACE_BUFFER_SIZE
+#define E_TRACE_BUFFER_SIZE 128
+#endif
+
+#ifndef E_LINK_STATS_RTT_BUCKETS
+#define E_LINK_STATS_RTT_BUCKETS 12
+#endif
+
+#ifndef E_ESCAPE_GUARD_TIME
+#define E_ESCAPE_GUARD_TIME 1000
+#endif
+
+#ifndef E_DEFAULT_TASK_PRIORITY
+#define E_DEFAULT_TASK_PRIORITY 0
+#endif
+
+#ifndef E_COMMDEVICE_TASK_PRIORITY
+#define E_COMMDEVICE_TASK_PRIORITY 1
+#endif
+
+#ifndef E_SERIAL_TASK_PRIORITY
+#define E_SERIAL_TASK_PRIORITY 2
+#endif
+
+#ifndef E_TIMER_WHEEL_LEVELS
+#define E_TIMER_WHEEL_LEVELS 4
+#endif
+
+#ifndef E_TIMER_WHEEL_SLOT_BITS
+#define E_TIMER_WHEEL_SLOT_BITS 6
+#endif
+
+#ifndef E_TIMER_WHEEL_MAX_DELAY
+#define E_TIMER_WHEEL_MAX_DELAY 100
+#endif
+
+#ifndef E_COROUTINE_FRAME_SIZE
+#define E_COROUTINE_FRAME_SIZE 512
+#endif
+
+#ifndef E_COROUTINE_FRAMES
+#define E_COROUTINE_FRAMES 4
+#endif
+
 #ifndef E_INTERRUPT_PRIORITY
 #define E_INTERRUPT_PRIORITY 15
 #endif
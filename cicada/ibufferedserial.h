@@ -29,6 +29,8 @@
 
 namespace Cicada {
 
+class Task;
+
 /*!
  * \class IBufferedSerial
  *
@@ -64,8 +66,9 @@ class IBufferedSerial : public ICommDevice, public ISerial
     /*!
      * Writes a singla char to the buffer.
      * \param data Character to write
+     * \return true if written, false if the write buffer is full
      */
-    virtual void write(uint8_t data) = 0;
+    virtual bool write(uint8_t data) = 0;
 
     /*!
      * \return true if a whole line is in the buffer, false otherwise
@@ -93,6 +96,19 @@ class IBufferedSerial : public ICommDevice, public ISerial
      * \return Buffer size of read/write buffer
      */
     virtual Size bufferSize() = 0;
+
+    /*!
+     * Sets a task to be notified whenever new data arrives in the read
+     * buffer, so the task can wait with Task::waitForEvent() instead of
+     * polling the serial device. The default implementation ignores the
+     * task, so a comm device on such a serial is never woken up by
+     * incoming data and only runs again on requests of the application.
+     * \param task Task to notify, or NULL for none
+     */
+    virtual void setReceiveTask(Task* task)
+    {
+        (void)task;
+    }
 };
 
 }
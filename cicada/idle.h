@@ -0,0 +1,48 @@
+/*
+ * E-Lib
+ * Copyright (C) 2019 EnAccess
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef EIDLE_H
+#define EIDLE_H
+
+#include <cstdint>
+#include "cicada/defines.h"
+
+/*!
+ * Puts the CPU or process to sleep until maxIdleTime has passed or
+ * eWakeupFunction() is called, whichever comes first. Passed to the
+ * Scheduler, which calls it when no task is due. A maxIdleTime of
+ * E_TICK_MAX means there is no timeout.
+ * \param maxIdleTime Maximum sleep time in ticks
+ */
+void eIdleFunction(E_TICK_TYPE maxIdleTime);
+
+/*!
+ * Ends a sleep in eIdleFunction() early. Call this from interrupt
+ * handlers or other threads after making a task ready, for example with
+ * Task::notify(). On microcontrollers, any interrupt ends the sleep, so
+ * this function may do nothing.
+ */
+void eWakeupFunction();
+
+#endif
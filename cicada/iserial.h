@@ -24,6 +24,9 @@
 #ifndef EISERIAL_H
 #define EISERIAL_H
 
+#include "cicada/types.h"
+#include <cstdint>
+
 namespace Cicada {
 
 /*!
@@ -33,6 +36,12 @@ namespace Cicada {
  * rawWrite() shall be implemented to read/write from the according hardware
  * register. The IBufferedSerial / BufferedSerial classes access those
  * method to perform read/write on a higher level.
+ *
+ * rawRead() and rawWrite() exist in a single byte and in a block variant.
+ * Each variant has a default implementation based on the other one, so a
+ * driver needs to implement at least one of them. Drivers which can move
+ * blocks of data at once, like Unix file descriptors or DMA, should
+ * implement the block variants.
  */
 class ISerial
 {
@@ -77,14 +86,54 @@ class ISerial
      * \param data Place to store data read
      * \return true if read was successful, false otherwise
      */
-    virtual bool rawRead(uint8_t& data) = 0;
+    virtual bool rawRead(uint8_t& data)
+    {
+        return rawRead(&data, 1) == 1;
+    }
 
     /*!
      * Writes one byte of data to the device.
      * \param data byte to be written
      * \return true if write was successful, false otherwise
      */
-    virtual bool rawWrite(uint8_t data) = 0;
+    virtual bool rawWrite(uint8_t data)
+    {
+        return rawWrite(&data, 1) == 1;
+    }
+
+    /*!
+     * Reads as many bytes as are available from the device, but
+     * not more than maxSize.
+     * \param data Buffer to store the data read
+     * \param maxSize Maximum number of bytes to read
+     * \return Number of bytes actually read
+     */
+    virtual Size rawRead(uint8_t* data, Size maxSize)
+    {
+        Size readCount = 0;
+
+        while (readCount < maxSize && rawRead(data[readCount]))
+            readCount++;
+
+        return readCount;
+    }
+
+    /*!
+     * Writes as many bytes as the device accepts without blocking,
+     * but not more than size.
+     * \param data Buffer with the data to be written
+     * \param size Number of bytes in data
+     * \return Number of bytes actually written
+     */
+    virtual Size rawWrite(const uint8_t* data, Size size)
+    {
+        Size writeCount = 0;
+
+        while (writeCount < size && rawWrite(data[writeCount]))
+            writeCount++;
+
+        return writeCount;
+    }
 
     /*!
      * Starts transmission. This would usually set the according
@@ -21,11 +21,14 @@
  *
  */
 
+
 #ifndef LINE_CIRCULAR_BUFFER_H
 #define LINE_CIRCULAR_BUFFER_H
 
 #include "cicada/circularbuffer.h"
 #include <cstdint>
+#include <cstring>
+#include <type_traits>
 
 namespace Cicada {
 
@@ -33,95 +36,169 @@ namespace Cicada {
  * \class LineCircularBuffer
  *
  * Extends the circular buffer for handling lines.
+ *
+ * The buffer keeps a small index with the positions of line ends. New
+ * data is scanned for '\n' only once, the first time the consumer asks
+ * for lines, so the producer (usually an interrupt handler) does no extra
+ * work. Full lines can then be copied with readLine() in at most two
+ * memcpy() calls, or inspected in place with peekLine().
+ *
+ * numBufferedLines(), readLine() and peekLine() are consumer methods.
+ * If more than LINE_INDEX_SIZE lines are buffered, the remaining lines
+ * are indexed as soon as indexed lines have been read. Until then,
+ * numBufferedLines() counts them with an extra scan.
  */
 
-template <Size BUFFER_SIZE>
-class LineCircularBuffer : public CircularBuffer<char, BUFFER_SIZE>
+template <Size BUFFER_SIZE, Size LINE_INDEX_SIZE = 32>
+class LineCircularBuffer
+    : public CircularBuffer<char, BUFFER_SIZE, LineCircularBuffer<BUFFER_SIZE, LINE_INDEX_SIZE> >
 {
+    typedef CircularBuffer<char, BUFFER_SIZE, LineCircularBuffer<BUFFER_SIZE, LINE_INDEX_SIZE> >
+        Base;
+    friend Base;
+
   public:
     LineCircularBuffer() :
-        _bufferedLines(0)
+        _readPos(0),
+        _scanPos(0)
     { }
 
-    Size push(const char* data, Size size) override
+    /*!
+     * \return Number of lines currently in the buffer
+     */
+    inline uint16_t numBufferedLines() const
     {
-        if (size > CircularBuffer<char, BUFFER_SIZE>::spaceAvailable())
-            size = CircularBuffer<char, BUFFER_SIZE>::spaceAvailable();
-
-        Size writeCount = 0;
+        indexLines();
 
-        while (writeCount < size) {
-            push(data[writeCount++]);
-        }
+        Size lines = _lineEnds.bytesAvailable();
+        if (_lineEnds.isFull())
+            lines += countUnindexedLines();
 
-        return writeCount;
+        return lines;
     }
 
-    void push(char data) override
+    /*!
+     * Reads a full line from the buffer. If there is no full line,
+     * all available data is read. Characters which don't fit into
+     * data are discarded.
+     * \param data Pointer where pulled data will be stored
+     * \param size Available space in data
+     * \return Actual number of characters pulled from the buffer
+     */
+    Size readLine(char* data, Size size)
     {
-        CircularBuffer<char, BUFFER_SIZE>::push(data);
+        Size lineLength = nextLineLength();
+        if (lineLength == 0)
+            lineLength = Base::bytesAvailable();
 
-        if (data == '\n') {
-            _bufferedLines++;
-        }
+        Size readCount = Base::pull(data, lineLength < size ? lineLength : size);
+        Base::discard(lineLength - readCount);
+
+        return readCount;
     }
 
-    virtual Size pull(char* data, Size size) override
+    /*!
+     * Returns the next full line, including the '\n', without removing
+     * it from the buffer. As the line can wrap around the end of the
+     * buffer, it is returned in up to two parts. To remove the line
+     * afterwards, call commitRead(firstSize) and commitRead(secondSize).
+     * \param first Set to the first part of the line
+     * \param firstSize Set to the size of the first part
+     * \param second Set to the second part of the line
+     * \param secondSize Set to the size of the second part, 0 if the line
+     * doesn't wrap around
+     * \return Length of the line, or 0 if there is no full line
+     */
+    Size peekLine(const char*& first, Size& firstSize, const char*& second, Size& secondSize) const
     {
-        if (size > CircularBuffer<char, BUFFER_SIZE>::bytesAvailable())
-            size = CircularBuffer<char, BUFFER_SIZE>::bytesAvailable();
+        Size lineLength = nextLineLength();
 
-        Size readCount = 0;
+        first = Base::linearReadSpan(firstSize);
+        if (firstSize > lineLength)
+            firstSize = lineLength;
 
-        while (readCount < size) {
-            data[readCount++] = pull();
-        }
+        second = Base::linearReadSpan(secondSize, firstSize);
+        if (secondSize > lineLength - firstSize)
+            secondSize = lineLength - firstSize;
 
-        return readCount;
+        return lineLength;
     }
 
-    char pull() override
+  private:
+    typedef E_RING_INDEX_TYPE Position;
+    typedef std::make_signed<Position>::type PositionDiff;
+
+    void onRead(const char*, Size size)
     {
-        char data = CircularBuffer<char, BUFFER_SIZE>::pull();
+        _readPos += size;
 
-        if (data == '\n') {
-            _bufferedLines--;
-        }
+        while (!_lineEnds.isEmpty() && (PositionDiff)(_lineEnds.read() - _readPos) < 0)
+            _lineEnds.pull();
 
-        return data;
+        if ((PositionDiff)(_scanPos - _readPos) < 0)
+            _scanPos = _readPos;
     }
 
-    /*!
-     * \return Number of lines currently in the buffer
-     */
-    inline uint16_t numBufferedLines() const
+    Size nextLineLength() const
     {
-        return _bufferedLines;
+        indexLines();
+
+        if (_lineEnds.isEmpty())
+            return 0;
+
+        return _lineEnds.read() - _readPos + 1;
     }
 
-    /*!
-     * Reads a full line from the buffer.
-     * \param data Pointer where pulled data will be stored
-     * \param size Available space in data
-     * \return Actual number of characters pulled from the buffer
-     */
-    Size readLine(char* data, Size size)
+    // Scan data which arrived since the last call for line ends
+    void indexLines() const
     {
-        Size readCount = 0;
-        char c = '\0';
+        Size available = Base::bytesAvailable();
+
+        while (!_lineEnds.isFull()) {
+            Size spanSize;
+            const char* span = Base::linearReadSpan(spanSize, (Position)(_scanPos - _readPos));
+            if (spanSize == 0)
+                break;
+
+            const char* lineEnd = (const char*)memchr(span, '\n', spanSize);
+            if (lineEnd) {
+                _scanPos += lineEnd - span;
+                _lineEnds.push(_scanPos++);
+            } else {
+                _scanPos += spanSize;
+            }
 
-        while (!CircularBuffer<char, BUFFER_SIZE>::isEmpty() && c != '\n') {
-            c = pull();
-            if (readCount < size) {
-                data[readCount++] = c;
+            if ((Position)(_scanPos - _readPos) >= available)
+                break;
+        }
+    }
+
+    // Count the line ends in the data the full index has no room for
+    Size countUnindexedLines() const
+    {
+        Size lines = 0;
+        Size offset = (Position)(_scanPos - _readPos);
+
+        while (true) {
+            Size spanSize;
+            const char* span = Base::linearReadSpan(spanSize, offset);
+            if (spanSize == 0)
+                break;
+
+            const char* end = span + spanSize;
+            while ((span = (const char*)memchr(span, '\n', end - span)) != NULL) {
+                lines++;
+                span++;
             }
+            offset += spanSize;
         }
 
-        return readCount;
+        return lines;
     }
 
-  private:
-    uint16_t _bufferedLines;
+    Position _readPos;
+    mutable Position _scanPos;
+    mutable CircularBuffer<Position, LINE_INDEX_SIZE> _lineEnds;
 };
 
 }
@@ -23,10 +23,11 @@
 
 #include "cicada/mqttcountdown.h"
 #include "cicada/tick.h"
+#include <type_traits>
 
 using namespace Cicada;
 
-MQTTCountdown::MQTTCountdown() {}
+MQTTCountdown::MQTTCountdown() : _endTime(eTickFunction()) {}
 
 MQTTCountdown::MQTTCountdown(int ms)
 {
@@ -50,7 +51,9 @@ void MQTTCountdown::countdown(int seconds)
 
 int MQTTCountdown::left_ms()
 {
-    int64_t left = (int64_t)_endTime - eTickFunction();
+    // Signed difference stays correct when the tick wraps around
+    typedef std::make_signed<E_TICK_TYPE>::type SignedTick;
+    SignedTick left = (SignedTick)(_endTime - eTickFunction());
     if (left < 0)
         left = 0;
 
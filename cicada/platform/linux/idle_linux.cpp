@@ -0,0 +1,72 @@
+/*
+ * E-Lib
+ * Copyright (C) 2019 EnAccess
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "cicada/idle.h"
+#include <climits>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+// Self-pipe to interrupt the sleep from other threads
+static int wakeupPipe[2] = { -1, -1 };
+
+static bool initWakeupPipe()
+{
+    if (wakeupPipe[0] >= 0)
+        return true;
+
+    if (pipe(wakeupPipe) < 0)
+        return false;
+
+    fcntl(wakeupPipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(wakeupPipe[1], F_SETFL, O_NONBLOCK);
+
+    return true;
+}
+
+void eIdleFunction(E_TICK_TYPE maxIdleTime)
+{
+    int timeout = maxIdleTime == E_TICK_MAX || maxIdleTime > INT_MAX ? -1 : (int)maxIdleTime;
+
+    if (!initWakeupPipe()) {
+        usleep(timeout < 0 ? 1000 : timeout * 1000);
+        return;
+    }
+
+    struct pollfd fds = { wakeupPipe[0], POLLIN, 0 };
+    if (poll(&fds, 1, timeout) > 0) {
+        char drain[16];
+        while (read(wakeupPipe[0], drain, sizeof(drain)) > 0) { }
+    }
+}
+
+void eWakeupFunction()
+{
+    if (initWakeupPipe()) {
+        char c = 0;
+        if (write(wakeupPipe[1], &c, 1) < 0) {
+            // Pipe is full, the scheduler wakes up anyway
+        }
+    }
+}
@@ -0,0 +1,482 @@
+/*
+ * E-Lib
+ * Copyright (C) 2019 EnAccess
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "modememulator.h"
+#include <cstdio>
+#include <cstring>
+
+using namespace Cicada;
+
+// Configuration commands which are simply acknowledged
+static const char* const okCommands[] = {
+    "AT+CGSOCKCONT=",
+    "AT+CSOCKSETPN=",
+    "AT+CIPMODE=0",
+    "AT+CIPRXGET=1",
+    "AT+CIPMUX=1",
+    "AT+CSTT=",
+    "AT+CIICR",
+    NULL
+};
+
+static const char* const resolvedIp = "192.0.2.1";
+
+ModemEmulator::ModemEmulator(Dialect dialect, E_TICK_TYPE (*tickFunction)()) :
+    _dialect(dialect),
+    _tickFunction(tickFunction),
+    _isOpen(false),
+    _echo(true),
+    _baudRate(115200),
+    _rtt(0),
+    _sendAckDelay(0),
+    _lossPercent(0),
+    _random(1),
+    _peer(NULL),
+    _peerContext(NULL),
+    _creditTick(tickFunction()),
+    _rxCredit(0),
+    _txCredit(0),
+    _lineFill(0),
+    _sendLink(0),
+    _sendLeft(0),
+    _sendSize(0),
+    _sendDrop(false),
+    _chunkLeft(0),
+    _lastDue(0),
+    _bytesSent(0),
+    _bytesReceived(0)
+{
+    for (uint8_t i = 0; i < EMULATOR_LINKS; i++) {
+        _links[i].open = false;
+    }
+}
+
+bool ModemEmulator::open()
+{
+    _isOpen = true;
+    _creditTick = _tickFunction();
+    return true;
+}
+
+bool ModemEmulator::setSerialConfig(uint32_t baudRate, uint8_t dataBits)
+{
+    (void)dataBits;
+    _baudRate = baudRate;
+    return true;
+}
+
+void ModemEmulator::close()
+{
+    _isOpen = false;
+}
+
+void ModemEmulator::setRoundTripTime(E_TICK_TYPE rtt)
+{
+    _rtt = rtt;
+}
+
+void ModemEmulator::setSendAckDelay(E_TICK_TYPE delay)
+{
+    _sendAckDelay = delay;
+}
+
+void ModemEmulator::setLoss(uint8_t percent, uint32_t seed)
+{
+    _lossPercent = percent;
+    _random = seed;
+}
+
+void ModemEmulator::setPeer(PeerFunction peer, void* context)
+{
+    _peer = peer;
+    _peerContext = context;
+}
+
+void ModemEmulator::closeLink(uint8_t link)
+{
+    if (link >= EMULATOR_LINKS || !_links[link].open)
+        return;
+
+    _links[link].open = false;
+
+    char line[24];
+    if (_dialect == sim800)
+        snprintf(line, sizeof(line), "%u, CLOSED", link);
+    else
+        snprintf(line, sizeof(line), "+IPCLOSE: %u,1", link);
+    emitLine(line);
+}
+
+void ModemEmulator::sendUrc(const char* line)
+{
+    emitLine(line);
+}
+
+Size ModemEmulator::rawRead(uint8_t* data, Size maxSize)
+{
+    E_TICK_TYPE now = _tickFunction();
+    update();
+    refillCredit(now);
+
+    Size count = 0;
+    while (count < maxSize) {
+        if (_chunkLeft == 0) {
+            if (_outChunks.isEmpty()
+                || (E_TICK_TYPE)(now - _outChunks.read().due) > E_TICK_MAX / 2)
+                break;
+            _chunkLeft = _outChunks.pull().size;
+        }
+
+        Size size = maxSize - count;
+        if (size > _chunkLeft)
+            size = _chunkLeft;
+        if (_baudRate) {
+            if (size > _rxCredit / 10)
+                size = _rxCredit / 10;
+            if (size == 0)
+                break;
+            _rxCredit -= size * 10;
+        }
+
+        _out.pull(data + count, size);
+        count += size;
+        _chunkLeft -= size;
+    }
+
+    return count;
+}
+
+Size ModemEmulator::rawWrite(const uint8_t* data, Size size)
+{
+    E_TICK_TYPE now = _tickFunction();
+    update();
+    refillCredit(now);
+
+    if (_baudRate) {
+        if (size > _txCredit / 10)
+            size = _txCredit / 10;
+        _txCredit -= size * 10;
+    }
+
+    for (Size i = 0; i < size; i++) {
+        uint8_t c = data[i];
+
+        // Payload after the > prompt of CIPSEND
+        if (_sendLeft) {
+            if (!_sendDrop)
+                _payload[_sendSize++] = c;
+            _bytesSent++;
+            if (--_sendLeft == 0)
+                endPayload();
+            continue;
+        }
+
+        if (c == '\r')
+            continue;
+
+        if (c == '\n') {
+            _line[_lineFill] = '\0';
+            _lineFill = 0;
+            if (_echo) {
+                emit((const uint8_t*)_line, strlen(_line));
+                emit((const uint8_t*)"\r", 1);
+            }
+            if (_line[0])
+                command(_line);
+        } else if (_lineFill < EMULATOR_LINE_LENGTH - 1) {
+            _line[_lineFill++] = c;
+        }
+    }
+
+    return size;
+}
+
+void ModemEmulator::update()
+{
+    // Acknowledge sent data once the delay is over
+    E_TICK_TYPE now = _tickFunction();
+    while (!_acks.isEmpty() && (E_TICK_TYPE)(now - _acks.read().due) <= E_TICK_MAX / 2) {
+        Ack ack = _acks.pull();
+        acknowledge(ack.link, ack.size);
+    }
+
+    // Make echoed data readable once it went around the network
+    for (uint8_t i = 0; i < EMULATOR_LINKS; i++) {
+        Link& link = _links[i];
+        while (link.open && !link.arrivals.isEmpty()
+            && (E_TICK_TYPE)(now - link.arrivals.read().due) <= E_TICK_MAX / 2) {
+            Chunk arrival = link.arrivals.pull();
+            bool notify = link.readable == 0;
+            link.readable += arrival.size;
+            if (link.datagram)
+                link.datagrams.push(arrival.size);
+
+            if (notify) {
+                char line[24];
+                snprintf(line, sizeof(line), "+CIPRXGET: 1,%u", i);
+                emitLine(line);
+            }
+        }
+    }
+}
+
+void ModemEmulator::refillCredit(E_TICK_TYPE now)
+{
+    // Bits the serial line could have transferred since the last call,
+    // with at most 10ms worth of backlog
+    if (_baudRate == 0)
+        return;
+
+    uint64_t bits = (uint64_t)(E_TICK_TYPE)(now - _creditTick) * _baudRate / 1000;
+    uint32_t max = _baudRate / 100 > 10 ? _baudRate / 100 : 10;
+    _creditTick = now;
+
+    _rxCredit = _rxCredit + bits > max ? max : _rxCredit + bits;
+    _txCredit = _txCredit + bits > max ? max : _txCredit + bits;
+}
+
+void ModemEmulator::reset()
+{
+    closeAll();
+    _echo = true;
+    _lineFill = 0;
+    _sendLeft = 0;
+    _acks.flush();
+}
+
+void ModemEmulator::command(const char* line)
+{
+    unsigned int link, length;
+    char text[80];
+
+    if (strcmp(line, "AT") == 0) {
+        emitLine("OK");
+    } else if (strcmp(line, "ATE0") == 0) {
+        _echo = false;
+        emitLine("OK");
+    } else if (strcmp(line, "AT+CRESET") == 0) {
+        emitLine("OK");
+        reset();
+        emitLine("RDY", _rtt);
+    } else if (strcmp(line, "AT+CSQ") == 0) {
+        emitLine("+CSQ: 20,99");
+        emitLine("OK");
+    } else if (strcmp(line, "AT+NETOPEN") == 0) {
+        emitLine("OK");
+        emitLine("+NETOPEN: 0", _rtt);
+    } else if (strcmp(line, "AT+NETCLOSE") == 0) {
+        closeAll();
+        emitLine("OK");
+        emitLine("+NETCLOSE: 0", _rtt);
+    } else if (strcmp(line, "AT+CIPSHUT") == 0) {
+        closeAll();
+        emitLine("SHUT OK");
+    } else if (strcmp(line, "AT+CIFSR") == 0) {
+        emitLine("10.64.0.2");
+    } else if (sscanf(line, "AT+CDNSGIP=\"%40[^\"]\"", text) == 1) {
+        char reply[EMULATOR_LINE_LENGTH];
+        snprintf(reply, sizeof(reply), "+CDNSGIP: 1,\"%s\",\"%s\"", text, resolvedIp);
+        if (_dialect == sim800) {
+            emitLine("OK");
+            emitLine(reply, _rtt);
+        } else {
+            emitLine(reply, _rtt);
+            emitLine("OK");
+        }
+    } else if (sscanf(line, "AT+CIPOPEN=%u,\"%3[A-Z]\"", &link, text) == 2
+        && link < EMULATOR_LINKS && !_links[link].open) {
+        openLink(link, strcmp(text, "UDP") == 0);
+        emitLine("OK");
+        snprintf(text, sizeof(text), "+CIPOPEN: %u,0", link);
+        emitLine(text, _rtt);
+    } else if (sscanf(line, "AT+CIPSTART=%u,\"%3[A-Z]\"", &link, text) == 2
+        && link < EMULATOR_LINKS && !_links[link].open) {
+        openLink(link, strcmp(text, "UDP") == 0);
+        emitLine("OK");
+        snprintf(text, sizeof(text), "%u, CONNECT OK", link);
+        emitLine(text, _rtt);
+    } else if (sscanf(line, "AT+CIPSEND=%u,%u", &link, &length) == 2 && link < EMULATOR_LINKS
+        && _links[link].open && length > 0 && length <= EMULATOR_PAYLOAD_SIZE
+        && !_links[link].arrivals.isFull() && !_acks.isFull()) {
+        startPayload(link, length);
+    } else if (sscanf(line, "AT+CIPRXGET=4,%u", &link) == 1 && link < EMULATOR_LINKS) {
+        snprintf(text, sizeof(text), "+CIPRXGET: 4,%u,%u", link,
+            (unsigned int)_links[link].readable);
+        emitLine(text);
+        emitLine("OK");
+    } else if (sscanf(line, "AT+CIPRXGET=2,%u,%u", &link, &length) == 2
+        && link < EMULATOR_LINKS) {
+        receiveData(link, length);
+    } else if (sscanf(line, "AT+CIPCLOSE=%u", &link) == 1 && link < EMULATOR_LINKS) {
+        _links[link].open = false;
+        if (_dialect == sim800) {
+            snprintf(text, sizeof(text), "%u, CLOSE OK", link);
+            emitLine(text, _rtt);
+        } else {
+            emitLine("OK");
+            snprintf(text, sizeof(text), "+CIPCLOSE: %u,0", link);
+            emitLine(text, _rtt);
+        }
+    } else {
+        for (const char* const* cmd = okCommands; *cmd; cmd++) {
+            if (strncmp(line, *cmd, strlen(*cmd)) == 0) {
+                emitLine("OK");
+                return;
+            }
+        }
+        emitLine("ERROR");
+    }
+}
+
+void ModemEmulator::openLink(uint8_t link, bool datagram)
+{
+    Link& l = _links[link];
+    l.open = true;
+    l.datagram = datagram;
+    l.readable = 0;
+    l.data.flush();
+    l.arrivals.flush();
+    l.datagrams.flush();
+}
+
+void ModemEmulator::closeAll()
+{
+    for (uint8_t i = 0; i < EMULATOR_LINKS; i++) {
+        _links[i].open = false;
+    }
+}
+
+void ModemEmulator::startPayload(uint8_t link, Size size)
+{
+    // A lost datagram isn't stored at all
+    _sendLink = link;
+    _sendLeft = size;
+    _sendSize = 0;
+    _sendDrop = _links[link].datagram && lost();
+    emit((const uint8_t*)"\r\n>", 3);
+}
+
+void ModemEmulator::endPayload()
+{
+    Link& link = _links[_sendLink];
+    E_TICK_TYPE now = _tickFunction();
+
+    if (!_sendDrop) {
+        const uint8_t* data = _payload;
+        Size size = _sendSize;
+        uint8_t reply[EMULATOR_PAYLOAD_SIZE];
+        if (_peer) {
+            data = reply;
+            size = _peer(_sendLink, _payload, _sendSize, reply, sizeof(reply), _peerContext);
+        }
+
+        // Lost TCP segments come back after a retransmission timeout
+        Chunk arrival = { now + _rtt, link.data.push(data, size) };
+        if (!link.datagram && lost())
+            arrival.due += 3 * _rtt;
+        if (arrival.size > 0)
+            link.arrivals.push(arrival);
+    }
+
+    if (_sendAckDelay) {
+        Ack ack = { now + _sendAckDelay, _sendLink, _sendSize };
+        _acks.push(ack);
+    } else {
+        acknowledge(_sendLink, _sendSize);
+    }
+}
+
+void ModemEmulator::acknowledge(uint8_t link, Size size)
+{
+    char text[40];
+    if (_dialect == sim800) {
+        snprintf(text, sizeof(text), "%u, SEND OK", link);
+        emitLine(text, _rtt);
+    } else {
+        emitLine("OK");
+        snprintf(text, sizeof(text), "+CIPSEND: %u,%u,%u", link, (unsigned int)size,
+            (unsigned int)size);
+        emitLine(text, _rtt);
+    }
+}
+
+void ModemEmulator::receiveData(uint8_t link, Size size)
+{
+    // +CIPRXGET: 2,<link>,<length>,<remaining>, the data and OK.
+    // Datagrams are returned one at a time, the rest of a datagram
+    // which doesn't fit is discarded.
+    Link& l = _links[link];
+    Size available = l.readable;
+    if (l.datagram && !l.datagrams.isEmpty())
+        available = l.datagrams.pull();
+
+    Size length = available < size ? available : size;
+    l.readable -= l.datagram ? available : length;
+
+    char text[48];
+    snprintf(text, sizeof(text), "+CIPRXGET: 2,%u,%u,%u", link, (unsigned int)length,
+        (unsigned int)l.readable);
+    emitLine(text);
+
+    uint8_t buffer[256];
+    Size left = length;
+    while (left) {
+        Size chunk = l.data.pull(buffer, left < sizeof(buffer) ? left : sizeof(buffer));
+        emit(buffer, chunk);
+        left -= chunk;
+    }
+    if (l.datagram)
+        l.data.discard(available - length);
+
+    _bytesReceived += length;
+    emitLine("OK");
+}
+
+void ModemEmulator::emit(const uint8_t* data, Size size, E_TICK_TYPE delay)
+{
+    // Output keeps its order, a reply can't overtake an earlier one
+    E_TICK_TYPE due = _tickFunction() + delay;
+    if ((E_TICK_TYPE)(due - _lastDue) > E_TICK_MAX / 2)
+        due = _lastDue;
+    _lastDue = due;
+
+    Chunk chunk = { due, _out.push(data, size) };
+    _outChunks.push(chunk);
+}
+
+void ModemEmulator::emitLine(const char* line, E_TICK_TYPE delay)
+{
+    char text[EMULATOR_LINE_LENGTH + 4];
+    int size = snprintf(text, sizeof(text), "\r\n%s\r\n", line);
+    emit((const uint8_t*)text, size, delay);
+}
+
+bool ModemEmulator::lost()
+{
+    if (_lossPercent == 0)
+        return false;
+
+    _random = _random * 1103515245 + 12345;
+    return (_random >> 16) % 100 < _lossPercent;
+}
@@ -0,0 +1,250 @@
+/*
+ * E-Lib
+ * Copyright (C) 2019 EnAccess
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef EMODEMEMULATOR_H
+#define EMODEMEMULATOR_H
+
+#include "cicada/bufferedserial.h"
+#include "cicada/circularbuffer.h"
+#include <stdint.h>
+
+#define EMULATOR_LINKS 10
+#define EMULATOR_LINK_BUFFERSIZE 8192
+#define EMULATOR_LINE_LENGTH 128
+#define EMULATOR_PAYLOAD_SIZE 2048
+
+namespace Cicada {
+
+/*!
+ * \class ModemEmulator
+ *
+ * Serial device emulating a SIM7x00 or SIM800 modem, for running the
+ * modem drivers on a PC without hardware or network. It understands
+ * the AT commands the drivers use: NETOPEN, CDNSGIP, CIPOPEN/CIPSTART,
+ * CIPSEND, CIPRXGET, CIPCLOSE, CSQ and CRESET. Every link is connected
+ * to an echo peer in the emulator itself, so data sent comes back as
+ * received data after the round trip time, announced by +CIPRXGET: 1.
+ * The echo can be replaced with setPeer().
+ *
+ * Time is taken from the tick function given to the constructor, so
+ * runs are deterministic when the tick is simulated. The serial line
+ * is limited to the configured baud rate in both directions.
+ *
+ * Transparent mode (AT+CIPMODE=1) is not emulated.
+ */
+
+class ModemEmulator : public BufferedSerialTask
+{
+  public:
+    enum Dialect { sim7x00, sim800 };
+
+    /*!
+     * Peer replacing the echo. Called with every chunk sent on a link.
+     * \param link Link the data was sent on
+     * \param data Data sent by the driver
+     * \param size Size of data
+     * \param reply Buffer for the data coming back after the round trip
+     * \param maxSize Size of reply
+     * \param context Context pointer given to setPeer()
+     * \return Number of bytes in reply
+     */
+    typedef Size (*PeerFunction)(uint8_t link, const uint8_t* data, Size size, uint8_t* reply,
+        Size maxSize, void* context);
+
+    /*!
+     * \param dialect Modem to emulate
+     * \param tickFunction Function returning the current time in ms
+     */
+    ModemEmulator(Dialect dialect, E_TICK_TYPE (*tickFunction)());
+
+    virtual bool open();
+
+    inline virtual bool isOpen()
+    {
+        return _isOpen;
+    }
+
+    /*!
+     * Sets the emulated baud rate, 0 for an unlimited serial line.
+     */
+    virtual bool setSerialConfig(uint32_t baudRate, uint8_t dataBits);
+
+    virtual void close();
+
+    inline const char* portName() const
+    {
+        return "emulator";
+    }
+
+    /*!
+     * Sets the network round trip time. It delays the replies to
+     * NETOPEN, CDNSGIP, opening a connection, sending and the echo.
+     * \param rtt Round trip time in ms
+     */
+    void setRoundTripTime(E_TICK_TYPE rtt);
+
+    /*!
+     * Delays the acknowledgement of sent data, OK on the SIM7x00 and
+     * SEND OK on the SIM800. The prompt for a following AT+CIPSEND is
+     * not held back, so it overtakes the pending acknowledgements.
+     * \param delay Delay in ms
+     */
+    void setSendAckDelay(E_TICK_TYPE delay);
+
+    /*!
+     * Sets the chance for a sent chunk to get lost. Lost TCP data is
+     * retransmitted after three round trip times, lost UDP datagrams
+     * don't come back.
+     * \param percent Loss rate in percent
+     * \param seed Seed for the pseudo random numbers
+     */
+    void setLoss(uint8_t percent, uint32_t seed = 1);
+
+    /*!
+     * Sets a peer for all links instead of the echo, for example a
+     * protocol server stub.
+     * \param peer Function handling the data sent, NULL for the echo
+     * \param context Pointer passed to the peer
+     */
+    void setPeer(PeerFunction peer, void* context = NULL);
+
+    /*!
+     * Closes a link from the peer's side, with the according URC.
+     * \param link Link to close
+     */
+    void closeLink(uint8_t link);
+
+    /*!
+     * Sends a line to the driver right away, for example "+PDP: DEACT".
+     * \param line Line without line ending
+     */
+    void sendUrc(const char* line);
+
+    /*!
+     * \return Number of payload bytes received from the driver
+     */
+    inline uint32_t bytesSent() const
+    {
+        return _bytesSent;
+    }
+
+    /*!
+     * \return Number of payload bytes handed to the driver
+     */
+    inline uint32_t bytesReceived() const
+    {
+        return _bytesReceived;
+    }
+
+    /*!
+     * \return Number of sent chunks not acknowledged yet
+     */
+    inline Size acksPending() const
+    {
+        return _acks.bytesAvailable();
+    }
+
+  protected:
+    virtual Size rawRead(uint8_t* data, Size maxSize);
+
+    virtual Size rawWrite(const uint8_t* data, Size size);
+
+    virtual void startTransmit() {}
+
+  private:
+    struct Chunk
+    {
+        E_TICK_TYPE due;
+        Size size;
+    };
+
+    struct Ack
+    {
+        E_TICK_TYPE due;
+        uint8_t link;
+        Size size;
+    };
+
+    struct Link
+    {
+        bool open;
+        bool datagram;
+        Size readable;
+        CircularBuffer<uint8_t, EMULATOR_LINK_BUFFERSIZE> data;
+        CircularBuffer<Chunk, 32> arrivals;
+        CircularBuffer<Size, 32> datagrams;
+    };
+
+    void update();
+    void refillCredit(E_TICK_TYPE now);
+    void reset();
+    void command(const char* line);
+    void openLink(uint8_t link, bool datagram);
+    void closeAll();
+    void startPayload(uint8_t link, Size size);
+    void endPayload();
+    void acknowledge(uint8_t link, Size size);
+    void receiveData(uint8_t link, Size size);
+    void emit(const uint8_t* data, Size size, E_TICK_TYPE delay = 0);
+    void emitLine(const char* line, E_TICK_TYPE delay = 0);
+    bool lost();
+
+    Dialect _dialect;
+    E_TICK_TYPE (*_tickFunction)();
+    bool _isOpen;
+    bool _echo;
+    uint32_t _baudRate;
+    E_TICK_TYPE _rtt;
+    E_TICK_TYPE _sendAckDelay;
+    uint8_t _lossPercent;
+    uint32_t _random;
+    PeerFunction _peer;
+    void* _peerContext;
+
+    E_TICK_TYPE _creditTick;
+    uint32_t _rxCredit;
+    uint32_t _txCredit;
+
+    char _line[EMULATOR_LINE_LENGTH];
+    Size _lineFill;
+    uint8_t _sendLink;
+    Size _sendLeft;
+    Size _sendSize;
+    bool _sendDrop;
+    uint8_t _payload[EMULATOR_PAYLOAD_SIZE];
+    CircularBuffer<Ack, 32> _acks;
+
+    CircularBuffer<uint8_t, 8192> _out;
+    CircularBuffer<Chunk, 256> _outChunks;
+    Size _chunkLeft;
+    E_TICK_TYPE _lastDue;
+
+    Link _links[EMULATOR_LINKS];
+
+    uint32_t _bytesSent;
+    uint32_t _bytesReceived;
+};
+}
+
+#endif
@@ -0,0 +1,212 @@
+/*
+ * E-Lib
+ * Copyright (C) 2019 EnAccess
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "threadedunixserial.h"
+#include "cicada/idle.h"
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+using namespace Cicada;
+
+// Poll interval while the read buffer is full and no data can be accepted
+#define FULL_BUFFER_POLL_INTERVAL 10
+
+ThreadedUnixSerial::ThreadedUnixSerial(const char* port) :
+    UnixSerial(port),
+    _running(false),
+    _wakeupPipe(),
+    _waitBytes(0),
+    _waitLine(false)
+{
+    _wakeupPipe[0] = -1;
+    _wakeupPipe[1] = -1;
+}
+
+ThreadedUnixSerial::~ThreadedUnixSerial()
+{
+    close();
+}
+
+bool ThreadedUnixSerial::open()
+{
+    if (!UnixSerial::open())
+        return false;
+
+    if (pipe(_wakeupPipe) < 0) {
+        UnixSerial::close();
+        return false;
+    }
+    fcntl(_wakeupPipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(_wakeupPipe[1], F_SETFL, O_NONBLOCK);
+
+    _running = true;
+    _thread = std::thread(&ThreadedUnixSerial::ioThread, this);
+
+    return true;
+}
+
+void ThreadedUnixSerial::close()
+{
+    if (_running) {
+        _running = false;
+        wakeup();
+        _thread.join();
+    }
+
+    for (int i = 0; i < 2; i++) {
+        if (_wakeupPipe[i] >= 0)
+            ::close(_wakeupPipe[i]);
+        _wakeupPipe[i] = -1;
+    }
+
+    UnixSerial::close();
+}
+
+bool ThreadedUnixSerial::waitForLine(int timeout)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _waitLine = true;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool result = _dataAvailable.wait_for(
+        lock, std::chrono::milliseconds(timeout), [this] { return canReadLine(); });
+    _waitLine = false;
+
+    return result;
+}
+
+bool ThreadedUnixSerial::waitForBytes(Size count, int timeout)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _waitBytes = count;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool result = _dataAvailable.wait_for(
+        lock, std::chrono::milliseconds(timeout), [this, count] { return bytesAvailable() >= count; });
+    _waitBytes = 0;
+
+    return result;
+}
+
+void ThreadedUnixSerial::startTransmit()
+{
+    wakeup();
+}
+
+void ThreadedUnixSerial::wakeup()
+{
+    if (_wakeupPipe[1] >= 0) {
+        uint8_t c = 0;
+        if (::write(_wakeupPipe[1], &c, 1) < 0) {
+            // Pipe is full, the thread will wake up anyway
+        }
+    }
+}
+
+void ThreadedUnixSerial::notifyWaiters(bool lineReceived)
+{
+    // Pairs with the fence in the wait functions, so either the waiter
+    // sees the new data or we see the waiter
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    Size waitBytes = _waitBytes;
+    if ((lineReceived && _waitLine) || (waitBytes && _readBuffer.bytesAvailable() >= waitBytes)) {
+        // Taking the lock makes sure the waiter is either before its
+        // check or already waiting, so the notification can't get lost
+        _mutex.lock();
+        _mutex.unlock();
+        _dataAvailable.notify_all();
+    }
+
+    // Let a sleeping scheduler handle the new data
+    notifyReceiveTask();
+    eWakeupFunction();
+}
+
+void ThreadedUnixSerial::ioThread()
+{
+    struct pollfd fds[2];
+    fds[0].fd = _fd;
+    fds[1].fd = _wakeupPipe[0];
+    fds[1].events = POLLIN;
+
+    while (_running) {
+        bool readBufferFull = _readBuffer.isFull();
+
+        fds[0].events = 0;
+        fds[0].revents = 0;
+        fds[1].revents = 0;
+        if (!readBufferFull)
+            fds[0].events |= POLLIN;
+        if (!_writeBuffer.isEmpty())
+            fds[0].events |= POLLOUT;
+
+        if (poll(fds, 2, readBufferFull ? FULL_BUFFER_POLL_INTERVAL : -1) < 0)
+            continue;
+
+        if (fds[1].revents & POLLIN) {
+            uint8_t drain[16];
+            while (::read(_wakeupPipe[0], drain, sizeof(drain)) > 0) { }
+        }
+
+        if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+            // Device is gone, avoid spinning on the error condition
+            usleep(FULL_BUFFER_POLL_INTERVAL * 1000);
+        }
+
+        // Write as much as the device accepts
+        for (int i = 0; i < 2; i++) {
+            Size size;
+            const char* data = _writeBuffer.linearReadSpan(size);
+            if (size == 0)
+                break;
+
+            Size written = rawWrite((const uint8_t*)data, size);
+            _writeBuffer.commitRead(written);
+            if (written < size)
+                break;
+        }
+
+        // Read everything available into the read buffer
+        if (fds[0].revents & POLLIN) {
+            bool lineReceived = false;
+            for (int i = 0; i < 2; i++) {
+                Size size;
+                char* space = _readBuffer.linearWriteSpan(size);
+                if (size == 0)
+                    break;
+
+                Size read = rawRead((uint8_t*)space, size);
+                if (memchr(space, '\n', read))
+                    lineReceived = true;
+                _readBuffer.commitWrite(read);
+                if (read < size)
+                    break;
+            }
+
+            notifyWaiters(lineReceived);
+        }
+    }
+}
@@ -0,0 +1,111 @@
+/*
+ * E-Lib
+ * Copyright (C) 2019 EnAccess
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef ETHREADEDUNIXSERIAL_H
+#define ETHREADEDUNIXSERIAL_H
+
+#include "unixserial.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace Cicada {
+
+/*!
+ * \class ThreadedUnixSerial
+ *
+ * Event driven variant of UnixSerial. Instead of being polled from the
+ * Scheduler, a dedicated I/O thread blocks in poll() on the tty and on a
+ * wakeup pipe, and moves data in bulk between the device and the read and
+ * write buffers. write() wakes the thread through the pipe, so no CPU
+ * time is spent while the line is idle.
+ *
+ * The buffers are lock-free single producer / single consumer rings, so
+ * the application can use the usual read and write methods from its own
+ * thread. To block until data is available, use waitForLine() or
+ * waitForBytes(), which only wake up once their condition is met.
+ *
+ * Do not add this class to a Scheduler, its run() method does nothing.
+ */
+
+class ThreadedUnixSerial : public UnixSerial
+{
+  public:
+    /*!
+     * \param port Name of the serial port, see UnixSerial
+     */
+    ThreadedUnixSerial(const char* port = "/dev/ttyUSB0");
+    virtual ~ThreadedUnixSerial();
+
+    /*!
+     * Opens the serial device and starts the I/O thread.
+     */
+    virtual bool open();
+
+    /*!
+     * Stops the I/O thread and closes the serial device.
+     */
+    virtual void close();
+
+    /*!
+     * Blocks until a full line is available in the read buffer.
+     * \param timeout Maximum time to wait in milliseconds
+     * \return true if a line is available, false on timeout
+     */
+    bool waitForLine(int timeout);
+
+    /*!
+     * Blocks until at least count bytes are available in the read buffer.
+     * \param count Number of bytes to wait for
+     * \param timeout Maximum time to wait in milliseconds
+     * \return true if the data is available, false on timeout
+     */
+    bool waitForBytes(Size count, int timeout);
+
+    /*!
+     * The I/O thread does all the work, nothing to do here.
+     */
+    virtual void run() {}
+
+  protected:
+    virtual void startTransmit();
+
+  private:
+    void ioThread();
+    void wakeup();
+    void notifyWaiters(bool lineReceived);
+
+    std::thread _thread;
+    std::atomic<bool> _running;
+    int _wakeupPipe[2];
+
+    std::mutex _mutex;
+    std::condition_variable _dataAvailable;
+    std::atomic<Size> _waitBytes;
+    std::atomic<bool> _waitLine;
+};
+}
+
+#endif
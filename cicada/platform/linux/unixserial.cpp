@@ -206,12 +206,16 @@ void UnixSerial::close()
     _fd = -1;
 }
 
-bool UnixSerial::rawRead(uint8_t& data)
+Size UnixSerial::rawRead(uint8_t* data, Size maxSize)
 {
-    return ::read(_fd, &data, 1) == 1;
+    ssize_t readCount = ::read(_fd, data, maxSize);
+
+    return readCount > 0 ? readCount : 0;
 }
 
-bool UnixSerial::rawWrite(uint8_t data)
+Size UnixSerial::rawWrite(const uint8_t* data, Size size)
 {
-    return ::write(_fd, &data, 1) == 1;
+    ssize_t writeCount = ::write(_fd, data, size);
+
+    return writeCount > 0 ? writeCount : 0;
 }
@@ -40,8 +40,8 @@ namespace Cicada {
  * to connect to serial devices from a normal PC without the need
  * for an actual microcontroller hardware.
  *
- * It's implementation is very inefficient, reading/writing
- * one byte only at each system call. Not meant for production.
+ * The device is polled from the scheduler, reading/writing as much
+ * data as the buffers allow with each system call.
  */
 
 class UnixSerial : public BufferedSerialTask
@@ -72,13 +72,12 @@ class UnixSerial : public BufferedSerialTask
     }
 
   protected:
-    virtual bool rawRead(uint8_t& data);
+    virtual Size rawRead(uint8_t* data, Size maxSize);
 
-    virtual bool rawWrite(uint8_t data);
+    virtual Size rawWrite(const uint8_t* data, Size size);
 
     virtual void startTransmit() {}
 
-  private:
     bool _isOpen;
     const char* _port;
     int _fd;
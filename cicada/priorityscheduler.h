@@ -0,0 +1,310 @@
+/*
+ * E-Lib
+ * Copyright (C) 2019 EnAccess
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef EPRIORITYSCHEDULER_H
+#define EPRIORITYSCHEDULER_H
+
+#include "cicada/task.h"
+#include "cicada/types.h"
+#include <cstddef>
+#include <type_traits>
+
+namespace Cicada {
+
+/*!
+ * \class PriorityScheduler
+ *
+ * Alternative to Scheduler which runs tasks in order of their due time
+ * and priority instead of checking them round-robin. Tasks which are not
+ * due yet are kept in a min-heap ordered by `lastRun() + delay()`, so
+ * a due task never waits behind tasks which aren't due. Due tasks are run
+ * in rounds: at the start of a round, all due tasks are moved to a second
+ * heap ordered by Task::priority(), and each of them runs once, highest
+ * priority first. This way, the serial and modem tasks run before
+ * background work, but a task polling with delay 0 can't starve tasks
+ * with a lower priority.
+ *
+ * The heaps have a fixed capacity of MAX_TASKS, so no memory is
+ * allocated. Tasks in the task list beyond MAX_TASKS are ignored.
+ * Initial delays count from the construction of the scheduler, and a
+ * task's delay should only be changed from within its own run().
+ * Usage is the same as for Scheduler:
+ * ```
+ * Task* taskList[] = { &serial, &commDevice, &task1, NULL };
+ * PriorityScheduler<8> s(&eTickFunction, taskList, &eIdleFunction);
+ * s.start();
+ * ```
+ * With CICADA_TASK_STATS, run-time counters are collected the same way as
+ * by Scheduler.
+ */
+template <Size MAX_TASKS> class PriorityScheduler
+{
+  public:
+    /*!
+     * \param tickFunction pointer to a function returning the current
+     * system time tick
+     * \param taskList NULL-Terminated list of pointers to tasks
+     * for being handeled by the task scheduler
+     * \param idleFunction optional pointer to a function which sleeps
+     * for at most the given number of ticks
+     */
+    PriorityScheduler(E_TICK_TYPE (*tickFunction)(), Task* taskList[],
+        void (*idleFunction)(E_TICK_TYPE) = NULL) :
+        _tickFunction(tickFunction),
+        _idleFunction(idleFunction),
+        _numReady(0),
+        _numTimers(0),
+        _numWaiting(0)
+    {
+#ifdef CICADA_TASK_STATS
+        _taskList = taskList;
+        _statsClock = tickFunction;
+#endif
+        E_TICK_TYPE tick = _tickFunction();
+        for (Size i = 0; i < MAX_TASKS && taskList[i] != NULL; i++) {
+            taskList[i]->setLastRun(tick);
+            schedule(taskList[i]);
+        }
+    }
+
+    /*!
+     * Runs the next due task with the highest priority. If no task
+     * is due, calls the idle function if there is one.
+     */
+    void runTask()
+    {
+        if (_numReady == 0)
+            startRound();
+
+        if (_numReady == 0) {
+            if (_idleFunction) {
+                E_TICK_TYPE idleTime = timeToNextTask();
+                if (idleTime > 0)
+                    _idleFunction(idleTime);
+            }
+            return;
+        }
+
+        Task* task = popReady();
+#ifdef CICADA_TASK_STATS
+        E_TICK_TYPE due = deadline(task);
+        E_TICK_TYPE tick = _tickFunction();
+        E_TICK_TYPE clock = _statsClock();
+        task->setLastRun(tick);
+        task->run();
+        task->recordRun(due, tick, _tickFunction(), _statsClock() - clock);
+#else
+        task->setLastRun(_tickFunction());
+        task->run();
+#endif
+        schedule(task);
+    }
+
+    /*!
+     * Starts the scheduler. The method simply calls runTask()
+     * in a loop.
+     */
+    void start()
+    {
+        for (;;)
+            runTask();
+    }
+
+    /*!
+     * Calculates the time until the next task is due.
+     * \return 0 if a task is due, E_TICK_MAX if all tasks are waiting
+     * for an event, otherwise the number of ticks until the next task is due
+     */
+    E_TICK_TYPE timeToNextTask()
+    {
+        if (_numReady > 0)
+            return 0;
+
+        for (Size i = 0; i < _numWaiting; i++) {
+            if (!_waiting[i]->isWaiting())
+                return 0;
+        }
+
+        if (_numTimers == 0)
+            return E_TICK_MAX;
+
+        E_TICK_TYPE left = deadline(_timers[0]) - _tickFunction();
+        return (SignedTick)left <= 0 ? 0 : left;
+    }
+
+#ifdef CICADA_TASK_STATS
+    /*!
+     * \see Scheduler::setStatsClock()
+     */
+    void setStatsClock(E_TICK_TYPE (*statsClock)())
+    {
+        _statsClock = statsClock;
+    }
+
+    /*!
+     * \see Scheduler::dumpStats()
+     */
+    Size dumpStats(TaskStats* stats, Size maxStats) const
+    {
+        Size i = 0;
+        for (; i < maxStats && i < MAX_TASKS && _taskList[i] != NULL; i++)
+            stats[i] = _taskList[i]->stats();
+
+        return i;
+    }
+
+    /*!
+     * \see Scheduler::resetStats()
+     */
+    void resetStats()
+    {
+        for (Size i = 0; i < MAX_TASKS && _taskList[i] != NULL; i++)
+            _taskList[i]->resetStats();
+    }
+#endif
+
+  private:
+    typedef std::make_signed<E_TICK_TYPE>::type SignedTick;
+
+    static inline E_TICK_TYPE deadline(Task* task)
+    {
+        return task->lastRun() + task->delay();
+    }
+
+    // Wrap safe, as long as deadlines are less than half the tick range apart
+    static inline bool earlier(Task* a, Task* b)
+    {
+        return (SignedTick)(deadline(a) - deadline(b)) < 0;
+    }
+
+    static inline bool runsBefore(Task* a, Task* b)
+    {
+        if (a->priority() != b->priority())
+            return a->priority() > b->priority();
+
+        return earlier(a, b);
+    }
+
+    // Binary heap helpers, the root is the element for which
+    // `before` is true compared to all others
+    static void siftUp(Task** heap, Size pos, bool (*before)(Task*, Task*))
+    {
+        while (pos > 0) {
+            Size parent = (pos - 1) / 2;
+            if (!before(heap[pos], heap[parent]))
+                break;
+
+            Task* tmp = heap[pos];
+            heap[pos] = heap[parent];
+            heap[parent] = tmp;
+            pos = parent;
+        }
+    }
+
+    static void siftDown(Task** heap, Size size, bool (*before)(Task*, Task*))
+    {
+        Size pos = 0;
+        for (;;) {
+            Size first = pos;
+            Size left = 2 * pos + 1;
+            Size right = left + 1;
+
+            if (left < size && before(heap[left], heap[first]))
+                first = left;
+            if (right < size && before(heap[right], heap[first]))
+                first = right;
+            if (first == pos)
+                break;
+
+            Task* tmp = heap[pos];
+            heap[pos] = heap[first];
+            heap[first] = tmp;
+            pos = first;
+        }
+    }
+
+    static Task* pop(Task** heap, Size& size, bool (*before)(Task*, Task*))
+    {
+        Task* top = heap[0];
+        heap[0] = heap[--size];
+        siftDown(heap, size, before);
+        return top;
+    }
+
+    inline void pushReady(Task* task)
+    {
+        _ready[_numReady] = task;
+        siftUp(_ready, _numReady++, &runsBefore);
+    }
+
+    inline Task* popReady()
+    {
+        return pop(_ready, _numReady, &runsBefore);
+    }
+
+    // Sorts a task which just ran or was just added into the right set
+    void schedule(Task* task)
+    {
+        if (task->isWaiting()) {
+            _waiting[_numWaiting++] = task;
+        } else {
+            _timers[_numTimers] = task;
+            siftUp(_timers, _numTimers++, &earlier);
+        }
+    }
+
+    // Moves all due and notified tasks to the ready heap
+    void startRound()
+    {
+        E_TICK_TYPE tick = _tickFunction();
+
+        while (_numTimers > 0 && (SignedTick)(tick - deadline(_timers[0])) >= 0)
+            pushReady(pop(_timers, _numTimers, &earlier));
+
+        for (Size i = 0; i < _numWaiting;) {
+            if (_waiting[i]->isWaiting()) {
+                i++;
+            } else {
+                pushReady(_waiting[i]);
+                _waiting[i] = _waiting[--_numWaiting];
+            }
+        }
+    }
+
+    E_TICK_TYPE (*_tickFunction)();
+    void (*_idleFunction)(E_TICK_TYPE);
+    Task* _ready[MAX_TASKS];
+    Task* _timers[MAX_TASKS];
+    Task* _waiting[MAX_TASKS];
+    Size _numReady;
+    Size _numTimers;
+    Size _numWaiting;
+#ifdef CICADA_TASK_STATS
+    Task** _taskList;
+    E_TICK_TYPE (*_statsClock)();
+#endif
+};
+}
+
+#endif
@@ -26,24 +26,67 @@
 
 using namespace Cicada;
 
-Scheduler::Scheduler(E_TICK_TYPE (*tickFunction)(), Task** taskList) :
+Scheduler::Scheduler(
+    E_TICK_TYPE (*tickFunction)(), Task** taskList, void (*idleFunction)(E_TICK_TYPE)) :
     _tickFunction(tickFunction),
+    _idleFunction(idleFunction),
     _taskList(taskList),
     _currentTask(taskList)
-{}
+{
+#ifdef CICADA_TASK_STATS
+    _statsClock = tickFunction;
+#endif
+}
 
 void Scheduler::runTask()
 {
     E_TICK_TYPE tick = _tickFunction();
-    if ((*_currentTask)->delay() == 0
-        || tick - (*_currentTask)->lastRun() >= (*_currentTask)->delay()) {
+    if (!(*_currentTask)->isWaiting()
+        && ((*_currentTask)->delay() == 0
+            || tick - (*_currentTask)->lastRun() >= (*_currentTask)->delay())) {
+#ifdef CICADA_TASK_STATS
+        Task* task = *_currentTask;
+        E_TICK_TYPE due = task->lastRun() + task->delay();
+        E_TICK_TYPE clock = _statsClock();
+        task->setLastRun(tick);
+        task->run();
+        task->recordRun(due, tick, _tickFunction(), _statsClock() - clock);
+#else
         (*_currentTask)->setLastRun(tick);
         (*_currentTask)->run();
+#endif
     }
 
     if (*++_currentTask == NULL) {
         _currentTask = _taskList;
+
+        if (_idleFunction) {
+            E_TICK_TYPE idleTime = timeToNextTask();
+            if (idleTime > 0)
+                _idleFunction(idleTime);
+        }
+    }
+}
+
+E_TICK_TYPE Scheduler::timeToNextTask()
+{
+    E_TICK_TYPE tick = _tickFunction();
+    E_TICK_TYPE next = E_TICK_MAX;
+
+    for (Task** task = _taskList; *task != NULL; ++task) {
+        if ((*task)->isWaiting())
+            continue;
+
+        E_TICK_TYPE elapsed = tick - (*task)->lastRun();
+        if ((*task)->delay() == 0 || elapsed >= (*task)->delay())
+            return 0;
+
+        E_TICK_TYPE left = (*task)->delay() - elapsed;
+        if (left < next)
+            next = left;
     }
+
+    return next;
 }
 
 void Scheduler::start()
@@ -51,3 +94,25 @@ void Scheduler::start()
     for (;;)
         runTask();
 }
+
+#ifdef CICADA_TASK_STATS
+void Scheduler::setStatsClock(E_TICK_TYPE (*statsClock)())
+{
+    _statsClock = statsClock;
+}
+
+Size Scheduler::dumpStats(TaskStats* stats, Size maxStats) const
+{
+    Size i = 0;
+    for (; i < maxStats && _taskList[i] != NULL; i++)
+        stats[i] = _taskList[i]->stats();
+
+    return i;
+}
+
+void Scheduler::resetStats()
+{
+    for (Task** task = _taskList; *task != NULL; ++task)
+        (*task)->resetStats();
+}
+#endif
@@ -25,6 +25,8 @@
 #define ESCHEDULER_H
 
 #include "cicada/task.h"
+#include "cicada/types.h"
+#include <cstddef>
 
 namespace Cicada {
 
@@ -48,6 +50,20 @@ namespace Cicada {
  * 4. Call `s.start()` to run the main loop. This function runs in an indefinite
  * loop and never returns. Alternatively, you can also call `s.runTask()`
  * in your own loop.
+ *
+ * If an idle function (usually the global eIdleFunction()) is passed to the
+ * constructor, the scheduler calls it after each round through the task list
+ * when no task is due, with the time until the next task is due. Tasks
+ * waiting for an event (see E_REENTER_WAIT()) are not taken into account, so
+ * the idle function may sleep until it is woken up by an interrupt or
+ * eWakeupFunction(). A task which runs with a delay of 0, like
+ * BufferedSerialTask, keeps the scheduler from ever becoming idle. The comm
+ * devices wait for an event while their connection is idle, which requires
+ * a serial device moving its data from an interrupt handler or thread.
+ *
+ * When built with CICADA_TASK_STATS, the scheduler collects run-time
+ * counters for each task (see TaskStats), which can be read with
+ * dumpStats() to find tasks which block the loop or are starved.
  */
 
 class Scheduler
@@ -58,8 +74,11 @@ class Scheduler
      * system time tick
      * \param taskList NULL-Terminated list of pointers to tasks
      * for being handeled by the task scheduler
+     * \param idleFunction optional pointer to a function which sleeps
+     * for at most the given number of ticks
      */
-    Scheduler(E_TICK_TYPE (*tickFunction)(), Task* taskList[]);
+    Scheduler(E_TICK_TYPE (*tickFunction)(), Task* taskList[],
+        void (*idleFunction)(E_TICK_TYPE) = NULL);
 
     /*!
      * Check one task in the task list and if its due,
@@ -73,10 +92,46 @@ class Scheduler
      */
     void start();
 
+    /*!
+     * Calculates the time until the next task is due.
+     * \return 0 if a task is due, E_TICK_MAX if all tasks are waiting
+     * for an event, otherwise the number of ticks until the next task is due
+     */
+    E_TICK_TYPE timeToNextTask();
+
+#ifdef CICADA_TASK_STATS
+    /*!
+     * Sets the clock used to measure execution times of tasks. Ticks are
+     * usually too coarse for this, so a free running counter with a
+     * higher resolution, e.g. a microsecond timer or the cycle counter,
+     * should be used. Defaults to the tick function.
+     * \param statsClock pointer to a function returning the current
+     * counter value
+     */
+    void setStatsClock(E_TICK_TYPE (*statsClock)());
+
+    /*!
+     * Copies the run-time counters of the tasks in the order of the task list.
+     * \param stats array to copy the counters to
+     * \param maxStats size of the array
+     * \return number of tasks copied
+     */
+    Size dumpStats(TaskStats* stats, Size maxStats) const;
+
+    /*!
+     * Clears the run-time counters of all tasks.
+     */
+    void resetStats();
+#endif
+
   private:
     E_TICK_TYPE (*_tickFunction)();
+    void (*_idleFunction)(E_TICK_TYPE);
     Task** _taskList;
     Task** _currentTask;
+#ifdef CICADA_TASK_STATS
+    E_TICK_TYPE (*_statsClock)();
+#endif
 };
 }
 
@@ -30,6 +30,7 @@
 #define ETASK_H
 
 #include "cicada/defines.h"
+#include <atomic>
 #include <stdint.h>
 
 /*!
@@ -115,8 +116,48 @@
         if (!(COND))                                                                               \
             return;
 
+/*!
+ * \def E_REENTER_WAIT(COND)
+ * Continues if the condition is met, otherwise marks the task as waiting
+ * and yields to the task scheduler. Unlike E_REENTER_COND(), the
+ * scheduler does not poll a waiting task. Whoever makes the condition
+ * true has to call notify() on the task afterwards, which is safe to do
+ * from an interrupt handler. When notifying from another thread, call
+ * eWakeupFunction() as well to end the scheduler's idle sleep.
+ * \param COND Condition to be met to continue
+ */
+#define E_REENTER_WAIT(COND) E_REENTER_WAIT_ARG(__COUNTER__, COND)
+#define E_REENTER_WAIT_ARG(ENTRY_POINT, COND)                                                      \
+    setDelay(0);                                                                                   \
+    entrypoint = ENTRY_POINT;                                                                      \
+    case ENTRY_POINT:                                                                              \
+        waitForEvent();                                                                            \
+        if (!(COND))                                                                               \
+            return;                                                                                \
+        notify();
+
 namespace Cicada {
 
+#ifdef CICADA_TASK_STATS
+/*!
+ * Run-time counters of a single task, collected by the schedulers when
+ * the library is built with CICADA_TASK_STATS. Execution times are
+ * measured with the scheduler's stats clock (see Scheduler::setStatsClock()),
+ * lateness and gaps in ticks.
+ */
+struct TaskStats
+{
+    uint32_t runs;              /**< Number of calls to run() */
+    uint64_t totalTime;         /**< Sum of the execution times of run() */
+    E_TICK_TYPE maxTime;        /**< Longest execution time of run() */
+    uint64_t totalLateness;     /**< Sum of the delays between due time and start */
+    E_TICK_TYPE maxLateness;    /**< Longest delay between due time and start */
+    E_TICK_TYPE maxGap;         /**< Longest time from yielding until run() is called again */
+    E_TICK_TYPE lastYield;      /**< Tick when run() last returned */
+    bool waited;                /**< Task waited for an event, so it had no due time */
+};
+#endif
+
 /*!
  * \class Task
  * Base class for tasks which need to be called in regular intervals.
@@ -152,7 +193,20 @@ namespace Cicada {
 class Task
 {
   public:
-    Task(uint16_t initialDelay = 0) : _delay(initialDelay), _lastRun(0) {}
+    /*!
+     * \param initialDelay Delay before the first run
+     * \param priority Priority of the task, only used by PriorityScheduler
+     */
+    Task(uint16_t initialDelay = 0, uint8_t priority = E_DEFAULT_TASK_PRIORITY) :
+        _delay(initialDelay),
+        _lastRun(0),
+        _priority(priority),
+        _waiting(false)
+    {
+#ifdef CICADA_TASK_STATS
+        resetStats();
+#endif
+    }
 
     virtual ~Task() {}
 
@@ -191,6 +245,50 @@ class Task
         _lastRun = time;
     }
 
+    /*!
+     * Priority of the task. Higher values run first when several tasks
+     * are due at the same time.
+     */
+    inline uint8_t priority() const
+    {
+        return _priority;
+    }
+
+    /*!
+     * Set the priority of the task.
+     * \param priority New priority
+     */
+    inline void setPriority(uint8_t priority)
+    {
+        _priority = priority;
+    }
+
+    /*!
+     * Marks the task as waiting for an event. The scheduler will not
+     * run the task again until notify() is called.
+     */
+    inline void waitForEvent()
+    {
+        _waiting.store(true, std::memory_order_release);
+    }
+
+    /*!
+     * Makes a waiting task ready to run again. Can be called from
+     * interrupt handlers and other threads.
+     */
+    inline void notify()
+    {
+        _waiting.store(false, std::memory_order_release);
+    }
+
+    /*!
+     * \return true if the task is waiting for notify()
+     */
+    inline bool isWaiting() const
+    {
+        return _waiting.load(std::memory_order_acquire);
+    }
+
     /*!
      * The starting point for the task. The scheduler will call
      * this function regularly.
@@ -203,14 +301,70 @@ class Task
      */
     virtual void run() = 0;
 
+#ifdef CICADA_TASK_STATS
+    /*!
+     * \return Run-time counters of the task
+     */
+    inline const TaskStats& stats() const
+    {
+        return _stats;
+    }
+
+    /*!
+     * Clears the run-time counters of the task.
+     */
+    inline void resetStats()
+    {
+        _stats = TaskStats();
+    }
+
+    /*!
+     * Updates the run-time counters after a call to run(). Called by the
+     * schedulers.
+     * \param due Tick when the task was due
+     * \param start Tick when run() was called
+     * \param end Tick when run() returned
+     * \param time Execution time of run() in units of the stats clock
+     */
+    inline void recordRun(E_TICK_TYPE due, E_TICK_TYPE start, E_TICK_TYPE end, E_TICK_TYPE time)
+    {
+        // There is no sensible due time or gap before the first run,
+        // or for a task which has been woken up by notify()
+        if (_stats.runs > 0) {
+            if (!_stats.waited) {
+                E_TICK_TYPE lateness = start - due;
+                _stats.totalLateness += lateness;
+                if (lateness > _stats.maxLateness)
+                    _stats.maxLateness = lateness;
+            }
+
+            E_TICK_TYPE gap = start - _stats.lastYield;
+            if (gap > _stats.maxGap)
+                _stats.maxGap = gap;
+        }
+
+        _stats.runs++;
+        _stats.totalTime += time;
+        if (time > _stats.maxTime)
+            _stats.maxTime = time;
+        _stats.lastYield = end;
+        _stats.waited = isWaiting();
+    }
+#endif
+
   private:
     /*
      * Doesn't make sense to copy an Task object
      */
     Task(const Task&);
 
-    uint16_t _delay;      /**< Time before the task will run again */
-    E_TICK_TYPE _lastRun; /**< Stores the tick when the task last ran */
+    uint16_t _delay;            /**< Time before the task will run again */
+    E_TICK_TYPE _lastRun;       /**< Stores the tick when the task last ran */
+    uint8_t _priority;          /**< Run order of tasks which are due together */
+    std::atomic<bool> _waiting; /**< Task is skipped until notify() */
+#ifdef CICADA_TASK_STATS
+    TaskStats _stats;           /**< Run-time counters */
+#endif
 };
 }
 
@@ -0,0 +1,239 @@
+/*
+ * E-Lib
+ * Copyright (C) 2019 EnAccess
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "cicada/timerwheel.h"
+
+using namespace Cicada;
+
+static inline unsigned int countTrailingZeros(uint64_t bits)
+{
+    return __builtin_ctzll(bits);
+}
+
+TimerWheel::TimerWheel(E_TICK_TYPE (*tickFunction)()) :
+    _tickFunction(tickFunction),
+    _now(tickFunction()),
+    _numTimers(0),
+    _slots(),
+    _occupied()
+{
+    waitForEvent();
+}
+
+void TimerWheel::start(Timer& timer, E_TICK_TYPE timeout, Task* task)
+{
+    if (timer._state == Timer::running) {
+        unlink(timer);
+        _numTimers--;
+    }
+
+    E_TICK_TYPE tick = _tickFunction();
+
+    // The current tick may already be processed, so expire right away
+    if (timeout == 0) {
+        timer._expires = tick;
+        timer._state = Timer::expired;
+        if (task)
+            task->notify();
+        return;
+    }
+
+    // Keep expiry times comparable across tick wrap around
+    if (timeout > E_TICK_MAX / 2)
+        timeout = E_TICK_MAX / 2;
+
+    if (_numTimers == 0)
+        _now = tick;
+
+    timer._expires = tick + timeout;
+    timer._task = task;
+    timer._state = Timer::running;
+    insert(timer);
+    _numTimers++;
+
+    // Make sure the wheel runs in time for the new timer
+    if (isWaiting()) {
+        setDelay(0);
+        notify();
+    } else {
+        E_TICK_TYPE due = tick + timeToNextSlot(tick);
+        E_TICK_TYPE planned = lastRun() + delay();
+        if ((SignedTick)(due - planned) < 0)
+            setDelay(due - lastRun());
+    }
+}
+
+void TimerWheel::stop(Timer& timer)
+{
+    if (timer._state != Timer::running)
+        return;
+
+    unlink(timer);
+    _numTimers--;
+    timer._state = Timer::idle;
+}
+
+void TimerWheel::advance(E_TICK_TYPE tick)
+{
+    while (_numTimers > 0 && (SignedTick)(tick - _now) >= 0) {
+        unsigned int index = _now & SLOT_MASK;
+        if (index == 0)
+            cascade(1);
+
+        uint64_t bits = _occupied[0] >> index;
+        if (bits & 1) {
+            expireSlot(index);
+            _now++;
+            continue;
+        }
+
+        // Skip empty slots up to the next timer or cascade
+        E_TICK_TYPE skip = bits ? countTrailingZeros(bits) : SLOTS - index;
+        if (skip > tick - _now + 1)
+            skip = tick - _now + 1;
+        _now += skip;
+    }
+
+    if (_numTimers == 0 && (SignedTick)(tick - _now) >= 0)
+        _now = tick + 1;
+}
+
+E_TICK_TYPE TimerWheel::timeToNextSlot(E_TICK_TYPE tick) const
+{
+    if (_numTimers == 0)
+        return E_TICK_MAX;
+
+    // Slot 0 of the lowest level needs a cascade first
+    unsigned int index = _now & SLOT_MASK;
+    E_TICK_TYPE distance = 0;
+    if (index != 0) {
+        uint64_t bits = _occupied[0] >> index;
+        distance = bits ? countTrailingZeros(bits) : SLOTS - index;
+    }
+
+    E_TICK_TYPE next = _now + distance;
+    return (SignedTick)(next - tick) <= 0 ? 0 : next - tick;
+}
+
+void TimerWheel::run()
+{
+    E_TICK_TYPE tick = _tickFunction();
+    advance(tick);
+
+    E_TICK_TYPE next = timeToNextSlot(tick);
+    if (next == E_TICK_MAX) {
+        waitForEvent();
+        return;
+    }
+
+    if (next > E_TIMER_WHEEL_MAX_DELAY)
+        next = E_TIMER_WHEEL_MAX_DELAY;
+    setDelay(next);
+}
+
+void TimerWheel::insert(Timer& timer)
+{
+    E_TICK_TYPE diff = timer._expires - _now;
+    if ((SignedTick)diff < 0)
+        diff = 0;
+
+    // Find the lowest level covering the delay, the top level
+    // takes everything else and cascades it again later
+    unsigned int level = 0;
+    while (level + 1 < E_TIMER_WHEEL_LEVELS
+        && diff >= ((E_TICK_TYPE)1 << (E_TIMER_WHEEL_SLOT_BITS * (level + 1))))
+        level++;
+
+    const E_TICK_TYPE range = (E_TICK_TYPE)1 << (E_TIMER_WHEEL_SLOT_BITS * E_TIMER_WHEEL_LEVELS);
+    if (diff >= range)
+        diff = range - 1;
+
+    unsigned int slot = ((_now + diff) >> (E_TIMER_WHEEL_SLOT_BITS * level)) & SLOT_MASK;
+
+    timer._level = level;
+    timer._slot = slot;
+    timer._prev = NULL;
+    timer._next = _slots[level][slot];
+    if (timer._next)
+        timer._next->_prev = &timer;
+    _slots[level][slot] = &timer;
+    _occupied[level] |= (uint64_t)1 << slot;
+}
+
+void TimerWheel::unlink(Timer& timer)
+{
+    if (timer._prev)
+        timer._prev->_next = timer._next;
+    else
+        _slots[timer._level][timer._slot] = timer._next;
+
+    if (timer._next)
+        timer._next->_prev = timer._prev;
+
+    if (_slots[timer._level][timer._slot] == NULL)
+        _occupied[timer._level] &= ~((uint64_t)1 << timer._slot);
+
+    timer._next = NULL;
+    timer._prev = NULL;
+}
+
+void TimerWheel::cascade(unsigned int level)
+{
+    if (level >= E_TIMER_WHEEL_LEVELS)
+        return;
+
+    unsigned int index = (_now >> (E_TIMER_WHEEL_SLOT_BITS * level)) & SLOT_MASK;
+
+    Timer* timer = _slots[level][index];
+    _slots[level][index] = NULL;
+    _occupied[level] &= ~((uint64_t)1 << index);
+
+    while (timer) {
+        Timer* next = timer->_next;
+        insert(*timer);
+        timer = next;
+    }
+
+    // The next level moves down when this one wraps around
+    if (index == 0)
+        cascade(level + 1);
+}
+
+void TimerWheel::expireSlot(unsigned int slot)
+{
+    Timer* timer = _slots[0][slot];
+    _slots[0][slot] = NULL;
+    _occupied[0] &= ~((uint64_t)1 << slot);
+
+    while (timer) {
+        Timer* next = timer->_next;
+        timer->_next = NULL;
+        timer->_prev = NULL;
+        timer->_state = Timer::expired;
+        _numTimers--;
+        if (timer->_task)
+            timer->_task->notify();
+        timer = next;
+    }
+}
@@ -0,0 +1,200 @@
+/*
+ * E-Lib
+ * Copyright (C) 2019 EnAccess
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef ETIMERWHEEL_H
+#define ETIMERWHEEL_H
+
+#include "cicada/defines.h"
+#include "cicada/task.h"
+#include "cicada/types.h"
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/*!
+ * \def E_REENTER_TIMER(WHEEL, TIMER, DELAY)
+ * Starts TIMER on WHEEL and yields to the task scheduler until it
+ * expires. Unlike E_REENTER_DELAY(), DELAY isn't limited to 16 bit.
+ * \param WHEEL TimerWheel to register the timer with
+ * \param TIMER Timer object, usually a member of the task
+ * \param DELAY Delay in ticks
+ */
+#define E_REENTER_TIMER(WHEEL, TIMER, DELAY) E_REENTER_TIMER_ARG(__COUNTER__, WHEEL, TIMER, DELAY)
+#define E_REENTER_TIMER_ARG(ENTRY_POINT, WHEEL, TIMER, DELAY)                                      \
+    (WHEEL).start(TIMER, DELAY, this);                                                             \
+    E_REENTER_WAIT_ARG(ENTRY_POINT, (TIMER).hasExpired())
+
+namespace Cicada {
+
+/*!
+ * \class Timer
+ *
+ * A one-shot timer which can be registered with a TimerWheel. The
+ * timer doesn't allocate any memory, the wheel links the timers
+ * together directly.
+ */
+class Timer
+{
+  public:
+    Timer() : _next(NULL), _prev(NULL), _expires(0), _task(NULL), _state(idle) {}
+
+    /*!
+     * \return true if the timer is registered with a wheel and not yet expired
+     */
+    inline bool isRunning() const
+    {
+        return _state == running;
+    }
+
+    /*!
+     * \return true if the timer has expired since it was last started
+     */
+    inline bool hasExpired() const
+    {
+        return _state == expired;
+    }
+
+    /*!
+     * \return Tick at which the timer expires
+     */
+    inline E_TICK_TYPE expires() const
+    {
+        return _expires;
+    }
+
+  private:
+    friend class TimerWheel;
+
+    enum State : uint8_t { idle, running, expired };
+
+    Timer(const Timer&);
+
+    Timer* _next;
+    Timer* _prev;
+    E_TICK_TYPE _expires;
+    Task* _task;
+    uint8_t _level;
+    uint8_t _slot;
+    State _state;
+};
+
+/*!
+ * \class TimerWheel
+ *
+ * Hierarchical timer wheel, which keeps any number of Timer objects.
+ * Starting and stopping a timer is O(1), independent of the number of
+ * running timers. Each of the E_TIMER_WHEEL_LEVELS levels has
+ * 2^E_TIMER_WHEEL_SLOT_BITS slots, and each level covers a time range
+ * as big as the whole level below it. Timers are sorted into the lowest
+ * level which covers their delay and move down one level when the
+ * level below wraps around. Delays longer than the top level are
+ * supported and just cascade more often. Timer expiry times are compared
+ * wrap safe, the maximum delay is half the range of E_TICK_TYPE.
+ *
+ * The wheel is a Task itself and has to be added to the scheduler's task
+ * list. It only runs when the next slot with timers is due, and waits
+ * for an event when no timer is running. When a timer expires, the task
+ * passed to start() is notified. The wheel is not thread safe, so only
+ * use it from tasks of the same scheduler.
+ *
+ * With PriorityScheduler, a newly started timer which expires before
+ * the wheel's next run is handled late by up to E_TIMER_WHEEL_MAX_DELAY
+ * ticks, as PriorityScheduler only takes delay changes into account
+ * after a task's next run.
+ */
+class TimerWheel : public Task
+{
+  public:
+    /*!
+     * \param tickFunction pointer to a function returning the current
+     * system time tick
+     */
+    TimerWheel(E_TICK_TYPE (*tickFunction)());
+
+    /*!
+     * Starts or restarts a timer.
+     * \param timer Timer to start
+     * \param timeout Ticks from now until the timer expires
+     * \param task Task to be notified when the timer expires, can be NULL
+     */
+    void start(Timer& timer, E_TICK_TYPE timeout, Task* task = NULL);
+
+    /*!
+     * Stops a running timer. Does nothing if the timer isn't running.
+     * \param timer Timer to stop
+     */
+    void stop(Timer& timer);
+
+    /*!
+     * Expires all timers which are due at the given tick. Called by run(),
+     * but can also be called directly when the wheel isn't run by a
+     * Scheduler.
+     * \param tick Current tick
+     */
+    void advance(E_TICK_TYPE tick);
+
+    /*!
+     * \return Ticks until the wheel has to be advanced again,
+     * E_TICK_MAX if no timer is running
+     */
+    E_TICK_TYPE timeToNextSlot(E_TICK_TYPE tick) const;
+
+    /*!
+     * \return Number of running timers
+     */
+    inline Size numTimers() const
+    {
+        return _numTimers;
+    }
+
+    /*!
+     * Advances the wheel to the current tick and sets the delay
+     * for the next run.
+     */
+    virtual void run();
+
+  private:
+    typedef std::make_signed<E_TICK_TYPE>::type SignedTick;
+
+    static const unsigned int SLOTS = 1u << E_TIMER_WHEEL_SLOT_BITS;
+    static const unsigned int SLOT_MASK = SLOTS - 1;
+
+    static_assert(E_TIMER_WHEEL_SLOT_BITS <= 6, "Slot bitmap supports up to 64 slots");
+    static_assert(E_TIMER_WHEEL_LEVELS * E_TIMER_WHEEL_SLOT_BITS < sizeof(E_TICK_TYPE) * 8,
+        "Timer wheel range exceeds E_TICK_TYPE");
+
+    void insert(Timer& timer);
+    void unlink(Timer& timer);
+    void cascade(unsigned int level);
+    void expireSlot(unsigned int slot);
+
+    E_TICK_TYPE (*_tickFunction)();
+    E_TICK_TYPE _now; /**< Next tick to be processed */
+    Size _numTimers;
+    Timer* _slots[E_TIMER_WHEEL_LEVELS][SLOTS];
+    uint64_t _occupied[E_TIMER_WHEEL_LEVELS]; /**< One bit per non-empty slot */
+};
+}
+
+#endif
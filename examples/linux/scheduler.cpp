@@ -1,3 +1,4 @@
+#include "cicada/idle.h"
 #include "cicada/scheduler.h"
 #include "cicada/tick.h"
 #include <stdio.h>
@@ -12,6 +13,7 @@ class Task1 : public Task
     void wakeup()
     {
         m_wakeup = true;
+        notify();
     }
 
     virtual void run()
@@ -22,7 +24,7 @@ class Task1 : public Task
         E_REENTER_DELAY(2000);
 
         printf("Task 1 - step 2\n");
-        E_REENTER_COND(m_wakeup);
+        E_REENTER_WAIT(m_wakeup);
 
         printf("Task 1 - step 3\n");
 
@@ -76,6 +78,6 @@ int main(int argc, char* argv[])
 
     Task* taskList[] = { &task1, &task2, NULL };
 
-    Scheduler s(&eTickFunction, taskList);
+    Scheduler s(&eTickFunction, taskList, &eIdleFunction);
     s.start();
 }
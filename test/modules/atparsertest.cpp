@@ -0,0 +1,128 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <string.h>
+
+#include "cicada/commdevices/atparser.h"
+
+using namespace Cicada;
+
+TEST_GROUP(AtParserTest){};
+
+TEST(AtParserTest, ShouldClassifyKnownReplies)
+{
+    struct {
+        const char* line;
+        AtReply reply;
+        Size prefixLength;
+    } replies[] = {
+        { "+CDNSGIP: 0,10\r\n", atCdnsgipFail, 11 },
+        { "+CDNSGIP: 1,\"example.com\",\"93.184.216.34\"\r\n", atCdnsgip, 11 },
+        { "+CIPOPEN: 0,0\r\n", atCipopen, 10 },
+        { "+CIPRXGET: 1,0\r\n", atCiprxgetData, 12 },
+        { "+CIPRXGET: 2,0,64,0\r\n", atCiprxgetRead, 12 },
+        { "+CIPRXGET: 4,0,128\r\n", atCiprxgetLength, 12 },
+        { "+CME ERROR: 3\r\n", atCmeError, 10 },
+        { "+CSQ: 17,99\r\n", atCsq, 6 },
+        { "+IPCLOSE: 0,1\r\n", atIpclose, 10 },
+        { "+NETCLOSE: 0\r\n", atNetclose, 11 },
+        { "+NETOPEN: 0\r\n", atNetopen, 10 },
+        { "+PDP: DEACT\r\n", atPdpDeact, 11 },
+        { "0, CLOSE OK\r\n", atCloseOk, 11 },
+        { "0, CLOSED\r\n", atClosed, 9 },
+        { "0, CONNECT FAIL\r\n", atConnectFail, 15 },
+        { "0, CONNECT OK\r\n", atConnectOk, 13 },
+        { "0, SEND OK\r\n", atSendOk, 10 },
+        { "5, CONNECT OK\r\n", atConnectOk, 13 },
+        { "SEND OK\r\n", atSendOk, 7 },
+        { ">", atPrompt, 1 },
+        { "ERROR\r\n", atError, 5 },
+        { "OK\r\n", atOk, 2 },
+        { "RDY\r\n", atRdy, 3 },
+        { "SHUT OK\r\n", atShutOk, 7 },
+    };
+
+    for (Size i = 0; i < sizeof(replies) / sizeof(replies[0]); i++) {
+        Size prefixLength = 99;
+        CHECK_EQUAL(replies[i].reply, AtParser::classify(replies[i].line, prefixLength));
+        CHECK_EQUAL(replies[i].prefixLength, prefixLength);
+    }
+}
+
+TEST(AtParserTest, ShouldNotClassifyUnknownOrTruncatedLines)
+{
+    const char* lines[] = { "", "\r\n", "O", "+CIPRXGET: 3,0\r\n", "+CSQ 17\r\n", "0, CLOS\r\n",
+        "0,CLOSED\r\n", "AT+CSQ\r\n", "+CIPRXGET:", "ZZZ\r\n" };
+
+    for (Size i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) {
+        Size prefixLength = 99;
+        CHECK_EQUAL(atUnknown, AtParser::classify(lines[i], prefixLength));
+        CHECK_EQUAL(0, prefixLength);
+    }
+}
+
+TEST(AtParserTest, ShouldNameEveryReplyByItsPrefix)
+{
+    for (int reply = atUnknown + 1; reply <= atShutOk; reply++) {
+        const char* name = AtParser::replyName((AtReply)reply);
+        CHECK(name != NULL);
+
+        Size prefixLength;
+        CHECK_EQUAL(reply, AtParser::classify(name, prefixLength));
+    }
+
+    STRCMP_EQUAL("OK", AtParser::replyName(atOk));
+    POINTERS_EQUAL(NULL, AtParser::replyName(atUnknown));
+}
+
+TEST(AtParserTest, ShouldFormatUnsignedIntegers)
+{
+    char buffer[11];
+
+    CHECK_EQUAL(1, AtParser::formatUint(buffer, 0));
+    STRCMP_EQUAL("0", buffer);
+
+    CHECK_EQUAL(4, AtParser::formatUint(buffer, 1460));
+    STRCMP_EQUAL("1460", buffer);
+
+    CHECK_EQUAL(10, AtParser::formatUint(buffer, 4294967295u));
+    STRCMP_EQUAL("4294967295", buffer);
+}
+
+TEST(AtParserTest, ShouldReadNumericFields)
+{
+    uint32_t value;
+    AtTokenizer tokenizer(",0, 64 ,12\r\n");
+
+    CHECK(tokenizer.readUint(value));
+    CHECK_EQUAL(0, value);
+    CHECK(tokenizer.readUint(value));
+    CHECK_EQUAL(64, value);
+    CHECK(tokenizer.readUint(value));
+    CHECK_EQUAL(12, value);
+    CHECK_FALSE(tokenizer.readUint(value));
+}
+
+TEST(AtParserTest, ShouldReadQuotedAndSkippedFields)
+{
+    char field[16];
+    uint32_t value;
+    AtTokenizer tokenizer("1,\"example.com\",\"93.184.216.34\",7\r\n");
+
+    CHECK(tokenizer.readUint(value));
+    CHECK_EQUAL(1, value);
+    CHECK(tokenizer.readField(NULL, 0));
+    CHECK(tokenizer.readField(field, sizeof(field)));
+    STRCMP_EQUAL("93.184.216.34", field);
+    CHECK(tokenizer.readUint(value));
+    CHECK_EQUAL(7, value);
+}
+
+TEST(AtParserTest, ShouldTruncateLongFields)
+{
+    char field[5];
+    AtTokenizer tokenizer("\"example.com\"\r\n");
+
+    CHECK(tokenizer.readField(field, sizeof(field)));
+    STRCMP_EQUAL("exam", field);
+}
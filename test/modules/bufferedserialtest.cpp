@@ -1,6 +1,8 @@
 #include "CppUTest/TestHarness.h"
 #include "CppUTestExt/MockSupport.h"
 
+#include <string.h>
+
 #include "cicada/bufferedserial.h"
 
 using namespace Cicada;
@@ -100,6 +102,23 @@ TEST(BufferedSerialTest, ShouldHaveDataInMockSerialAfterWrite)
     STRNCMP_EQUAL(dataIn, dataOut, SIZE);
 }
 
+TEST(BufferedSerialTest, ShouldRejectSingleCharWhenWriteBufferIsFull)
+{
+    BufferedSerialMock bs;
+    uint8_t dataIn[E_SERIAL_BUFFERSIZE];
+
+    mock().expectNCalls(3, "startTransmit");
+
+    memset(dataIn, 'a', sizeof(dataIn));
+    Size space = bs.spaceAvailable();
+    CHECK_EQUAL(space, bs.write(dataIn, space));
+    CHECK_FALSE(bs.write((uint8_t)'b'));
+
+    // The char goes in once the transfer made room
+    bs.transferToAndFromBuffer();
+    CHECK(bs.write((uint8_t)'c'));
+}
+
 TEST(BufferedSerialTest, ShouldDetectLineBreaksAndReadIndividualLines)
 {
     BufferedSerialMock bs;
@@ -119,3 +138,26 @@ TEST(BufferedSerialTest, ShouldDetectLineBreaksAndReadIndividualLines)
     dataOut[outLen] = '\0';
     STRNCMP_EQUAL("Another line\n", dataOut, SIZE);
 }
+
+TEST(BufferedSerialTest, ShouldMoveAllAvailableDataInASingleTransfer)
+{
+    BufferedSerialMock bs;
+    const uint8_t SIZE = 20;
+    char dataIn[SIZE] = "123456789 987654321";
+    char dataOut[SIZE];
+
+    mock().expectOneCall("startTransmit");
+
+    bs._inBufferMock.push(dataIn, SIZE);
+    bs.write((uint8_t*)dataIn, SIZE);
+
+    bs.transferToAndFromBuffer();
+
+    uint8_t readLen = bs.read((uint8_t*)dataOut, SIZE);
+    CHECK_EQUAL(SIZE, readLen);
+    STRNCMP_EQUAL(dataIn, dataOut, SIZE);
+
+    uint8_t writtenLen = bs._outBufferMock.pull(dataOut, SIZE);
+    CHECK_EQUAL(SIZE, writtenLen);
+    STRNCMP_EQUAL(dataIn, dataOut, SIZE);
+}
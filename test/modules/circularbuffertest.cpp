@@ -1,6 +1,8 @@
 #include "CppUTest/TestHarness.h"
 #include "CppUTestExt/MockSupport.h"
 
+#include <string.h>
+
 #include "cicada/circularbuffer.h"
 
 using namespace Cicada;
@@ -148,3 +150,124 @@ TEST(CircularBufferTest, ShouldReadNothingAfterFlushingTheBuffer)
     CHECK_EQUAL(0, readLen);
     STRNCMP_EQUAL(expectedDataOut, dataOut, MAX_BUFFER_SIZE);
 }
+
+TEST(CircularBufferTest, ShouldPushAndPullAcrossTheBufferEnd)
+{
+    const uint8_t MAX_BUFFER_SIZE = 10;
+    CircularBuffer<char, MAX_BUFFER_SIZE> buffer;
+
+    const uint8_t SIZE = 8;
+    char dataIn[SIZE] = { 'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H' };
+    char dataOut[SIZE];
+
+    buffer.push(dataIn, 6);
+    buffer.pull(dataOut, 6);
+
+    uint8_t writeLen = buffer.push(dataIn, SIZE);
+    uint8_t availLen = buffer.bytesAvailable();
+    uint8_t readLen = buffer.pull(dataOut, SIZE);
+
+    CHECK_EQUAL(SIZE, writeLen);
+    CHECK_EQUAL(SIZE, availLen);
+    CHECK_EQUAL(SIZE, readLen);
+    MEMCMP_EQUAL(dataIn, dataOut, SIZE);
+    CHECK(buffer.isEmpty());
+}
+
+TEST(CircularBufferTest, ShouldReadAndWriteInPlaceWithLinearSpans)
+{
+    const uint8_t MAX_BUFFER_SIZE = 10;
+    CircularBuffer<char, MAX_BUFFER_SIZE> buffer;
+
+    char dataIn[] = "0123456";
+    char dataOut[MAX_BUFFER_SIZE];
+
+    buffer.push(dataIn, 7);
+    buffer.pull(dataOut, 5);
+
+    Size writeSpanSize;
+    char* writeSpan = buffer.linearWriteSpan(writeSpanSize);
+    CHECK_EQUAL(3, writeSpanSize);
+    memcpy(writeSpan, "ABC", 3);
+    buffer.commitWrite(3);
+
+    writeSpan = buffer.linearWriteSpan(writeSpanSize);
+    CHECK_EQUAL(5, writeSpanSize);
+    memcpy(writeSpan, "DE", 2);
+    buffer.commitWrite(2);
+
+    CHECK_EQUAL(7, buffer.bytesAvailable());
+
+    Size readSpanSize;
+    const char* readSpan = buffer.linearReadSpan(readSpanSize);
+    CHECK_EQUAL(5, readSpanSize);
+    STRNCMP_EQUAL("56ABC", readSpan, 5);
+    buffer.commitRead(5);
+
+    readSpan = buffer.linearReadSpan(readSpanSize);
+    CHECK_EQUAL(2, readSpanSize);
+    STRNCMP_EQUAL("DE", readSpan, 2);
+    buffer.commitRead(2);
+
+    CHECK(buffer.isEmpty());
+}
+
+TEST(CircularBufferTest, ShouldWrapIndicesOfPowerOfTwoBuffer)
+{
+    const uint8_t MAX_BUFFER_SIZE = 8;
+    CircularBuffer<char, MAX_BUFFER_SIZE> buffer;
+
+    const uint8_t SIZE = 5;
+    char dataIn[SIZE] = { 'A', 'B', 'C', 'D', 'E' };
+    char dataOut[SIZE];
+
+    for (int i = 0; i < 10; i++) {
+        uint8_t writeLen = buffer.push(dataIn, SIZE);
+        uint8_t availLen = buffer.bytesAvailable();
+        uint8_t readLen = buffer.pull(dataOut, SIZE);
+
+        CHECK_EQUAL(SIZE, writeLen);
+        CHECK_EQUAL(SIZE, availLen);
+        CHECK_EQUAL(SIZE, readLen);
+        MEMCMP_EQUAL(dataIn, dataOut, SIZE);
+    }
+
+    buffer.push(dataIn, SIZE);
+    buffer.push(dataIn, SIZE);
+
+    CHECK(buffer.isFull());
+    CHECK_EQUAL(0, buffer.spaceAvailable());
+}
+
+TEST(CircularBufferTest, ShouldOverwriteOldestElementWhenPushingIntoFullBuffer)
+{
+    const uint8_t MAX_BUFFER_SIZE = 3;
+    CircularBuffer<char, MAX_BUFFER_SIZE> buffer;
+    char dataOut[MAX_BUFFER_SIZE];
+
+    buffer.push('A');
+    buffer.push('B');
+    buffer.push('C');
+    buffer.push('D');
+
+    uint8_t readLen = buffer.pull(dataOut, MAX_BUFFER_SIZE);
+
+    CHECK_EQUAL(MAX_BUFFER_SIZE, readLen);
+    STRNCMP_EQUAL("BCD", dataOut, MAX_BUFFER_SIZE);
+}
+
+TEST(CircularBufferTest, ShouldDiscardElementsAcrossTheWrapAround)
+{
+    const uint8_t MAX_BUFFER_SIZE = 8;
+    CircularBuffer<char, MAX_BUFFER_SIZE> buffer;
+    char dataOut[MAX_BUFFER_SIZE];
+
+    buffer.push("123456", 6);
+    buffer.pull(dataOut, 4);
+    buffer.push("789AB", 5);
+
+    CHECK_EQUAL(5, buffer.discard(5));
+    CHECK_EQUAL(2, buffer.pull(dataOut, MAX_BUFFER_SIZE));
+    STRNCMP_EQUAL("AB", dataOut, 2);
+    CHECK_EQUAL(0, buffer.discard(1));
+}
@@ -0,0 +1,141 @@
+#include "CppUTest/TestHarness.h"
+
+#include "cicada/bufferedserial.h"
+#include "cicada/coroutinetask.h"
+#include "cicada/scheduler.h"
+#include <string.h>
+
+using namespace Cicada;
+
+static E_TICK_TYPE fakeTick;
+
+static E_TICK_TYPE fakeTickFunction()
+{
+    return fakeTick;
+}
+
+TEST_GROUP(CoroutineTaskTest)
+{
+    class SerialMock : public BufferedSerial
+    {
+      public:
+        bool open()
+        {
+            return true;
+        }
+        void close() {}
+
+        bool isOpen()
+        {
+            return true;
+        }
+
+        bool setSerialConfig(uint32_t baudRate, uint8_t dataBits)
+        {
+            return true;
+        }
+
+        const char* portName() const
+        {
+            return NULL;
+        }
+
+        void receive(const char* str)
+        {
+            _readBuffer.push(str, strlen(str));
+        }
+
+        virtual void startTransmit() {}
+    };
+
+    class CountingTask : public CoroutineTask
+    {
+      public:
+        CountingTask(SerialMock& serial) : _serial(serial), ready(false), steps(0), lineSize(0) {}
+
+        virtual Coroutine body()
+        {
+            int counter = 0;
+
+            co_await delay(100);
+            steps = ++counter;
+
+            co_await until([this] { return ready; });
+            steps = ++counter;
+
+            lineSize = co_await line(_serial, lineBuffer, sizeof(lineBuffer));
+            steps = ++counter;
+        }
+
+        SerialMock& _serial;
+        bool ready;
+        int steps;
+        Size lineSize;
+        char lineBuffer[32];
+    };
+
+    void setup()
+    {
+        fakeTick = 0;
+    }
+};
+
+TEST(CoroutineTaskTest, ShouldRunThroughAwaits)
+{
+    SerialMock serial;
+    CountingTask task(serial);
+    Task* taskList[] = { &task, NULL };
+    Scheduler s(&fakeTickFunction, taskList);
+
+    s.runTask();
+    CHECK_EQUAL(0, task.steps);
+    CHECK_EQUAL(1, CoroutineArena::framesInUse());
+
+    fakeTick = 99;
+    s.runTask();
+    CHECK_EQUAL(0, task.steps);
+
+    fakeTick = 100;
+    s.runTask();
+    CHECK_EQUAL(1, task.steps);
+
+    s.runTask();
+    CHECK_EQUAL(1, task.steps);
+    task.ready = true;
+    s.runTask();
+    CHECK_EQUAL(2, task.steps);
+
+    s.runTask();
+    CHECK_EQUAL(2, task.steps);
+    serial.receive("OK\r\n");
+    s.runTask();
+    CHECK_EQUAL(3, task.steps);
+    CHECK_EQUAL(4, task.lineSize);
+    STRNCMP_EQUAL("OK\r\n", task.lineBuffer, 4);
+
+    CHECK(task.isWaiting());
+    CHECK_EQUAL(0, CoroutineArena::framesInUse());
+}
+
+TEST(CoroutineTaskTest, ShouldKeepStatePerInstance)
+{
+    SerialMock serial;
+    CountingTask task1(serial);
+    CountingTask task2(serial);
+    Task* taskList[] = { &task1, &task2, NULL };
+    Scheduler s(&fakeTickFunction, taskList);
+
+    s.runTask();
+    s.runTask();
+    fakeTick = 100;
+    s.runTask();
+    s.runTask();
+    CHECK_EQUAL(1, task1.steps);
+    CHECK_EQUAL(1, task2.steps);
+
+    task1.ready = true;
+    s.runTask();
+    s.runTask();
+    CHECK_EQUAL(2, task1.steps);
+    CHECK_EQUAL(1, task2.steps);
+}
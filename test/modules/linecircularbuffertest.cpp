@@ -33,3 +33,101 @@ TEST(LineCircularBufferTest, ShouldDetectLineBreaksAndReadIndividualLines)
     CHECK_EQUAL(buffer.numBufferedLines(), 0);
     STRCMP_EQUAL(pulledLine, "Yet another line\n");
 }
+
+TEST(LineCircularBufferTest, ShouldCountLinesWrittenAndReadInPlace)
+{
+    LineCircularBuffer<16> buffer;
+    char dataOut[16];
+
+    buffer.push("0123456789", 10);
+    buffer.pull(dataOut, 10);
+
+    const char* lines = "OK\r\n+CSQ: 5\n";
+    Size spanSize;
+    char* span = buffer.linearWriteSpan(spanSize);
+    memcpy(span, lines, spanSize);
+    buffer.commitWrite(spanSize);
+    span = buffer.linearWriteSpan(spanSize);
+    memcpy(span, lines + 6, strlen(lines) - 6);
+    buffer.commitWrite(strlen(lines) - 6);
+
+    uint8_t linesAfterWrite = buffer.numBufferedLines();
+
+    const char* readSpan = buffer.linearReadSpan(spanSize);
+    buffer.commitRead(spanSize);
+    uint8_t linesAfterFirstRead = buffer.numBufferedLines();
+
+    readSpan = buffer.linearReadSpan(spanSize);
+    buffer.commitRead(spanSize);
+
+    CHECK_EQUAL(2, linesAfterWrite);
+    CHECK_EQUAL(1, linesAfterFirstRead);
+    CHECK_EQUAL(0, buffer.numBufferedLines());
+    STRNCMP_EQUAL("SQ: 5\n", readSpan, 6);
+}
+
+TEST(LineCircularBufferTest, ShouldPeekLineWrappingAroundTheBufferEnd)
+{
+    LineCircularBuffer<16> buffer;
+    char dataOut[16];
+
+    buffer.push("0123456789", 10);
+    buffer.pull(dataOut, 10);
+    buffer.push("+CSQ: 21,0\r\nOK", 14);
+
+    const char* first;
+    const char* second;
+    Size firstSize, secondSize;
+    Size lineLength = buffer.peekLine(first, firstSize, second, secondSize);
+
+    CHECK_EQUAL(12, lineLength);
+    CHECK_EQUAL(6, firstSize);
+    CHECK_EQUAL(6, secondSize);
+    STRNCMP_EQUAL("+CSQ: ", first, firstSize);
+    STRNCMP_EQUAL("21,0\r\n", second, secondSize);
+    CHECK_EQUAL(14, buffer.bytesAvailable());
+
+    buffer.commitRead(firstSize);
+    buffer.commitRead(secondSize);
+
+    CHECK_EQUAL(0, buffer.numBufferedLines());
+    CHECK_EQUAL(0, buffer.peekLine(first, firstSize, second, secondSize));
+    CHECK_EQUAL(2, buffer.bytesAvailable());
+}
+
+TEST(LineCircularBufferTest, ShouldDiscardCharactersNotFittingIntoTheLine)
+{
+    LineCircularBuffer<32> buffer;
+    char dataOut[8];
+
+    const char* lines = "+CIPRXGET: 1,0\nOK\n";
+    buffer.push(lines, strlen(lines));
+
+    Size firstLength = buffer.readLine(dataOut, 5);
+    Size secondLength = buffer.readLine(dataOut + 5, 3);
+
+    CHECK_EQUAL(5, firstLength);
+    CHECK_EQUAL(3, secondLength);
+    STRNCMP_EQUAL("+CIPROK\n", dataOut, 8);
+    CHECK(buffer.isEmpty());
+}
+
+TEST(LineCircularBufferTest, ShouldIndexRemainingLinesAfterLineIndexOverflow)
+{
+    LineCircularBuffer<64, 2> buffer;
+    char dataOut[8];
+
+    const char* lines = "1\n2\n3\n4\n5\n";
+    buffer.push(lines, strlen(lines));
+
+    uint8_t linesBeforeRead = buffer.numBufferedLines();
+    for (int i = 0; i < 5; i++) {
+        CHECK_EQUAL(5 - i, buffer.numBufferedLines());
+        Size len = buffer.readLine(dataOut, sizeof(dataOut));
+        CHECK_EQUAL(2, len);
+        CHECK_EQUAL('1' + i, dataOut[0]);
+    }
+
+    CHECK_EQUAL(5, linesBeforeRead);
+    CHECK_EQUAL(0, buffer.numBufferedLines());
+}
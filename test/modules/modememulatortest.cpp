@@ -0,0 +1,289 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <string.h>
+
+#include "cicada/commdevices/sim7x00.h"
+#include "cicada/commdevices/sim800.h"
+#include "cicada/platform/linux/modememulator.h"
+
+using namespace Cicada;
+
+static E_TICK_TYPE emulatorTick = 0;
+
+static E_TICK_TYPE emulatorTickFunction()
+{
+    return emulatorTick;
+}
+
+TEST_GROUP(ModemEmulatorTest)
+{
+    void setup()
+    {
+        emulatorTick = 0;
+    }
+
+    // Runs the driver and the emulator for the given number of ms
+    static void runFor(ModemEmulator& modem, Task& device, E_TICK_TYPE time)
+    {
+        for (E_TICK_TYPE i = 0; i < time; i++) {
+            emulatorTick++;
+            modem.run();
+            device.run();
+            modem.run();
+        }
+    }
+
+    // SIM7x00 which sends at most 400 bytes per AT+CIPSEND
+    class SmallChunkDevice : public Sim7x00CommDevice
+    {
+      public:
+        SmallChunkDevice(IBufferedSerial& serial) : Sim7x00CommDevice(serial)
+        {
+            _maxSendLength = 400;
+        }
+    };
+
+    // Peer which swallows all data
+    static Size discardPeer(uint8_t link, const uint8_t* data, Size size, uint8_t* reply,
+        Size maxSize, void* context)
+    {
+        return 0;
+    }
+
+    // SIM7x00 with read-ahead and access to its receive chunk size
+    class ReadAheadDevice : public Sim7x00CommDevice
+    {
+      public:
+        ReadAheadDevice(IBufferedSerial& serial) : Sim7x00CommDevice(serial)
+        {
+            setReceiveReadAhead(true);
+        }
+
+        Size receiveChunkSize() const
+        {
+            return _receiveChunkSize;
+        }
+    };
+
+    // SIM7x00 which always reads 256 bytes at a time
+    class FixedChunkDevice : public Sim7x00CommDevice
+    {
+      public:
+        FixedChunkDevice(IBufferedSerial& serial) : Sim7x00CommDevice(serial)
+        {
+            _maxReceiveLength = 256;
+            _receiveChunkSize = 256;
+        }
+    };
+
+    // Emulator reporting a small serial buffer, so a backlog counts early
+    class SmallBufferModem : public ModemEmulator
+    {
+      public:
+        SmallBufferModem() : ModemEmulator(ModemEmulator::sim7x00, emulatorTickFunction) {}
+
+        virtual Size bufferSize()
+        {
+            return 128;
+        }
+    };
+
+    // Peer which answers anything with the number of bytes given as context
+    static Size downloadPeer(uint8_t link, const uint8_t* data, Size size, uint8_t* reply,
+        Size maxSize, void* context)
+    {
+        Size length = *(Size*)context < maxSize ? *(Size*)context : maxSize;
+        memset(reply, 'd', length);
+        return length;
+    }
+
+    // Requests a download of the given size and reads it as it arrives
+    static Size download(ModemEmulator& modem, SimCommDevice& device, Size size)
+    {
+        uint8_t data[E_NETWORK_BUFFERSIZE];
+        Size received = 0;
+
+        modem.setPeer(downloadPeer, &size);
+        for (int i = 0; i < 1000 && device.spaceAvailable() < 3; i++)
+            runFor(modem, device, 1);
+        if (device.write((const uint8_t*)"get", 3) != 3)
+            return 0;
+
+        for (int i = 0; i < 10000 && received < size; i++) {
+            runFor(modem, device, 1);
+            received += device.read(data, sizeof(data));
+        }
+        return received;
+    }
+
+    // Connects, sends a message and measures the time until it came back
+    static void echo(ModemEmulator& modem, SimCommDevice& device, const char* message,
+        E_TICK_TYPE& time)
+    {
+        char data[64];
+        Size size = strlen(message);
+
+        device.setApn("internet");
+        device.setHostPort("example.com", 7);
+        CHECK(device.connect());
+        for (int i = 0; i < 5000 && !device.isConnected(); i++)
+            runFor(modem, device, 1);
+        CHECK(device.isConnected());
+
+        E_TICK_TYPE start = emulatorTick;
+        CHECK_EQUAL(size, device.write((const uint8_t*)message, size));
+        for (int i = 0; i < 5000 && device.bytesAvailable() < size; i++)
+            runFor(modem, device, 1);
+
+        CHECK_EQUAL(size, device.read((uint8_t*)data, sizeof(data)));
+        STRNCMP_EQUAL(message, data, size);
+        time = emulatorTick - start;
+    }
+};
+
+TEST(ModemEmulatorTest, ShouldEchoDataThroughSim7x00Driver)
+{
+    ModemEmulator modem(ModemEmulator::sim7x00, emulatorTickFunction);
+    Sim7x00CommDevice device(modem);
+
+    E_TICK_TYPE time;
+
+    modem.setRoundTripTime(50);
+    echo(modem, device, "hello", time);
+    CHECK(time >= 50);
+    CHECK_EQUAL(5, modem.bytesSent());
+    CHECK_EQUAL(5, modem.bytesReceived());
+
+    device.disconnect();
+    for (int i = 0; i < 1000 && !device.isIdle(); i++)
+        runFor(modem, device, 1);
+    CHECK(device.isIdle());
+}
+
+TEST(ModemEmulatorTest, ShouldEchoDataThroughSim800Driver)
+{
+    ModemEmulator modem(ModemEmulator::sim800, emulatorTickFunction);
+    Sim800CommDevice device(modem);
+
+    E_TICK_TYPE time;
+
+    modem.setRoundTripTime(50);
+    echo(modem, device, "hello", time);
+    CHECK(time >= 50);
+}
+
+TEST(ModemEmulatorTest, ShouldLimitSerialLineToBaudRate)
+{
+    ModemEmulator modem(ModemEmulator::sim7x00, emulatorTickFunction);
+    Sim7x00CommDevice device(modem);
+    E_TICK_TYPE time;
+
+    // 60 bytes of payload out and back in, at about 1 byte per ms
+    modem.setSerialConfig(9600, 8);
+    echo(modem, device, "012345678901234567890123456789012345678901234567890123456789", time);
+    CHECK(time >= 2 * 60);
+}
+
+TEST(ModemEmulatorTest, ShouldReportRemoteClose)
+{
+    ModemEmulator modem(ModemEmulator::sim7x00, emulatorTickFunction);
+    Sim7x00CommDevice device(modem);
+
+    E_TICK_TYPE time;
+
+    echo(modem, device, "hello", time);
+    modem.closeLink(0);
+    runFor(modem, device, 10);
+    CHECK_FALSE(device.isConnected());
+}
+
+TEST(ModemEmulatorTest, ShouldWaitForAllAcksWhenPipelining)
+{
+    ModemEmulator modem(ModemEmulator::sim7x00, emulatorTickFunction);
+    SmallChunkDevice device(modem);
+    uint8_t data[1200];
+    E_TICK_TYPE time;
+
+    echo(modem, device, "hello", time);
+    for (int i = 0; i < 1000 && device.spaceAvailable() < sizeof(data); i++)
+        runFor(modem, device, 1);
+
+    // Three chunks whose prompts arrive before the OKs of the earlier ones
+    device.setSendPipelining(true);
+    modem.setSendAckDelay(100);
+    modem.setPeer(discardPeer);
+    memset(data, 'x', sizeof(data));
+    CHECK_EQUAL(sizeof(data), device.write(data, sizeof(data)));
+
+    E_TICK_TYPE start = emulatorTick;
+    for (int i = 0; i < 5000 && device.spaceAvailable() == 0; i++)
+        runFor(modem, device, 1);
+
+    CHECK(device.spaceAvailable() > 0);
+    CHECK_EQUAL(0, modem.acksPending());
+    CHECK_EQUAL(5 + sizeof(data), modem.bytesSent());
+    CHECK(emulatorTick - start < 3 * 100);
+}
+
+TEST(ModemEmulatorTest, ShouldReadAheadWithoutAskingForRemainingData)
+{
+    ModemEmulator modem(ModemEmulator::sim7x00, emulatorTickFunction);
+    FixedChunkDevice device(modem);
+    E_TICK_TYPE time;
+
+    echo(modem, device, "hello", time);
+
+    // Every read tells what's left, so only the four reads go out
+    device.setReceiveReadAhead(true);
+    device.resetLinkStats();
+    CHECK_EQUAL(1000, download(modem, device, 1000));
+    CHECK_EQUAL(4, device.linkStats().receiveRoundTrips);
+
+    // Nothing left after the last read ends the transfer
+    runFor(modem, device, 100);
+    CHECK_EQUAL(4, device.linkStats().receiveRoundTrips);
+    CHECK(device.isWaiting());
+
+    // Without read-ahead, AT+CIPRXGET=4 asks before each read
+    device.setReceiveReadAhead(false);
+    device.resetLinkStats();
+    CHECK_EQUAL(1000, download(modem, device, 1000));
+    CHECK(device.linkStats().receiveRoundTrips > 4);
+}
+
+TEST(ModemEmulatorTest, ShouldReadAheadThroughSim800Driver)
+{
+    ModemEmulator modem(ModemEmulator::sim800, emulatorTickFunction);
+    Sim800CommDevice device(modem);
+    E_TICK_TYPE time;
+
+    echo(modem, device, "hello", time);
+
+    device.setReceiveReadAhead(true);
+    device.resetLinkStats();
+    CHECK_EQUAL(1000, download(modem, device, 1000));
+    CHECK_EQUAL(2, device.linkStats().receiveRoundTrips);
+}
+
+TEST(ModemEmulatorTest, ShouldAdaptReceiveChunkSizeToSerialBacklog)
+{
+    SmallBufferModem modem;
+    ReadAheadDevice device(modem);
+    E_TICK_TYPE time;
+
+    echo(modem, device, "hello", time);
+    CHECK_EQUAL(E_SERIAL_BUFFERSIZE / 2, device.receiveChunkSize());
+
+    // An unlimited serial line delivers each chunk at once, so the chunks
+    // are halved down to the minimum
+    modem.setSerialConfig(0, 8);
+    CHECK_EQUAL(2000, download(modem, device, 2000));
+    CHECK_EQUAL(64, device.receiveChunkSize());
+
+    // At about 1 byte per ms the driver keeps up, and the chunks are
+    // doubled up to the modem's limit
+    modem.setSerialConfig(9600, 8);
+    CHECK_EQUAL(2000, download(modem, device, 2000));
+    CHECK_EQUAL(1500, device.receiveChunkSize());
+}
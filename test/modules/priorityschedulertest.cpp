@@ -0,0 +1,132 @@
+#include "CppUTest/TestHarness.h"
+
+#include "cicada/priorityscheduler.h"
+#include <string.h>
+
+using namespace Cicada;
+
+static E_TICK_TYPE fakeTick;
+static char runOrder[16];
+static int idleCalls;
+
+static E_TICK_TYPE fakeTickFunction()
+{
+    return fakeTick;
+}
+
+static void fakeIdleFunction(E_TICK_TYPE maxIdleTime)
+{
+    fakeTick += maxIdleTime;
+    idleCalls++;
+}
+
+TEST_GROUP(PrioritySchedulerTest)
+{
+    class NamedTask : public Task
+    {
+      public:
+        NamedTask(char name, uint16_t delay, uint8_t priority) : Task(delay, priority), name(name)
+        {}
+
+        virtual void run()
+        {
+            size_t len = strlen(runOrder);
+            runOrder[len] = name;
+            runOrder[len + 1] = '\0';
+        }
+
+        char name;
+    };
+
+    void setup()
+    {
+        fakeTick = 0;
+        runOrder[0] = '\0';
+        idleCalls = 0;
+    }
+};
+
+TEST(PrioritySchedulerTest, ShouldRunDueTasksByPriority)
+{
+    NamedTask a('a', 10, 0);
+    NamedTask b('b', 10, 2);
+    NamedTask c('c', 10, 1);
+    Task* taskList[] = { &a, &b, &c, NULL };
+    PriorityScheduler<4> s(&fakeTickFunction, taskList);
+
+    fakeTick = 10;
+    s.runTask();
+    s.runTask();
+    s.runTask();
+    STRCMP_EQUAL("bca", runOrder);
+}
+
+TEST(PrioritySchedulerTest, ShouldRunEarliestDeadlineFirst)
+{
+    NamedTask a('a', 300, 0);
+    NamedTask b('b', 100, 0);
+    NamedTask c('c', 250, 0);
+    Task* taskList[] = { &a, &b, &c, NULL };
+    PriorityScheduler<4> s(&fakeTickFunction, taskList, &fakeIdleFunction);
+
+    for (int i = 0; i < 6; i++)
+        s.runTask();
+
+    STRCMP_EQUAL("bbc", runOrder);
+    CHECK_EQUAL(250, fakeTick);
+    CHECK_EQUAL(3, idleCalls);
+}
+
+TEST(PrioritySchedulerTest, ShouldNotStarveLowPriorityTasks)
+{
+    NamedTask a('a', 0, 0);
+    NamedTask b('b', 0, 5);
+    Task* taskList[] = { &a, &b, NULL };
+    PriorityScheduler<2> s(&fakeTickFunction, taskList);
+
+    for (int i = 0; i < 4; i++)
+        s.runTask();
+
+    STRCMP_EQUAL("baba", runOrder);
+}
+
+TEST(PrioritySchedulerTest, ShouldHandleTickWrapAround)
+{
+    fakeTick = E_TICK_MAX - 5;
+    NamedTask a('a', 10, 0);
+    Task* taskList[] = { &a, NULL };
+    PriorityScheduler<1> s(&fakeTickFunction, taskList);
+
+    CHECK_EQUAL(10, s.timeToNextTask());
+    fakeTick = 3;
+    s.runTask();
+    STRCMP_EQUAL("", runOrder);
+    fakeTick = 4;
+    s.runTask();
+    STRCMP_EQUAL("a", runOrder);
+}
+
+#ifdef CICADA_TASK_STATS
+TEST(PrioritySchedulerTest, ShouldCollectTaskStats)
+{
+    NamedTask a('a', 10, 0);
+    NamedTask b('b', 10, 2);
+    Task* taskList[] = { &a, &b, NULL };
+    PriorityScheduler<2> s(&fakeTickFunction, taskList);
+
+    fakeTick = 10;
+    s.runTask();
+    s.runTask();
+    fakeTick = 23;
+    s.runTask();
+    s.runTask();
+
+    TaskStats stats[3];
+    CHECK_EQUAL(2, s.dumpStats(stats, 3));
+    for (int i = 0; i < 2; i++) {
+        CHECK_EQUAL(2, stats[i].runs);
+        CHECK_EQUAL(3, stats[i].maxLateness);
+        CHECK_EQUAL(13, stats[i].maxGap);
+    }
+}
+#endif
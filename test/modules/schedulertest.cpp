@@ -0,0 +1,205 @@
+#include "CppUTest/TestHarness.h"
+
+#include "cicada/scheduler.h"
+
+using namespace Cicada;
+
+static E_TICK_TYPE fakeTick;
+static E_TICK_TYPE lastIdleTime;
+static int idleCalls;
+
+static E_TICK_TYPE fakeTickFunction()
+{
+    return fakeTick;
+}
+
+static void fakeIdleFunction(E_TICK_TYPE maxIdleTime)
+{
+    lastIdleTime = maxIdleTime;
+    idleCalls++;
+}
+
+TEST_GROUP(SchedulerTest)
+{
+    class CountingTask : public Task
+    {
+      public:
+        CountingTask(uint16_t initialDelay = 0) : Task(initialDelay), runs(0) {}
+
+        virtual void run()
+        {
+            runs++;
+        }
+
+        int runs;
+    };
+
+    class BusyTask : public Task
+    {
+      public:
+        BusyTask(uint16_t delay, E_TICK_TYPE busyTime) : Task(delay), busyTime(busyTime) {}
+
+        virtual void run()
+        {
+            fakeTick += busyTime;
+        }
+
+        E_TICK_TYPE busyTime;
+    };
+
+    class EventTask : public Task
+    {
+      public:
+        EventTask() : runs(0) {}
+
+        virtual void run()
+        {
+            runs++;
+            waitForEvent();
+        }
+
+        int runs;
+    };
+
+    class WaitingTask : public Task
+    {
+      public:
+        WaitingTask() : ready(false), passed(false) {}
+
+        virtual void run()
+        {
+            E_BEGIN_TASK
+
+            E_REENTER_WAIT(ready);
+            passed = true;
+
+            E_END_TASK
+        }
+
+        bool ready;
+        bool passed;
+    };
+
+    void setup()
+    {
+        fakeTick = 0;
+        lastIdleTime = 0;
+        idleCalls = 0;
+    }
+};
+
+TEST(SchedulerTest, ShouldIdleUntilNextTaskIsDue)
+{
+    CountingTask task1(100);
+    CountingTask task2(30);
+    Task* taskList[] = { &task1, &task2, NULL };
+    Scheduler s(&fakeTickFunction, taskList, &fakeIdleFunction);
+
+    fakeTick = 10;
+    s.runTask();
+    s.runTask();
+    CHECK_EQUAL(0, task1.runs);
+    CHECK_EQUAL(0, task2.runs);
+    CHECK_EQUAL(1, idleCalls);
+    CHECK_EQUAL(20, lastIdleTime);
+
+    fakeTick = 30;
+    s.runTask();
+    s.runTask();
+    CHECK_EQUAL(0, task1.runs);
+    CHECK_EQUAL(1, task2.runs);
+    CHECK_EQUAL(2, idleCalls);
+    CHECK_EQUAL(30, lastIdleTime);
+}
+
+TEST(SchedulerTest, ShouldNotIdleWithPollingTask)
+{
+    CountingTask task1;
+    Task* taskList[] = { &task1, NULL };
+    Scheduler s(&fakeTickFunction, taskList, &fakeIdleFunction);
+
+    s.runTask();
+    s.runTask();
+    CHECK_EQUAL(2, task1.runs);
+    CHECK_EQUAL(0, idleCalls);
+}
+
+TEST(SchedulerTest, ShouldHandleTickWrapAround)
+{
+    CountingTask task1(100);
+    Task* taskList[] = { &task1, NULL };
+    Scheduler s(&fakeTickFunction, taskList, &fakeIdleFunction);
+
+    task1.setLastRun(E_TICK_MAX - 49);
+    fakeTick = 10;
+    CHECK_EQUAL(40, s.timeToNextTask());
+
+    fakeTick = 50;
+    s.runTask();
+    CHECK_EQUAL(1, task1.runs);
+}
+
+TEST(SchedulerTest, ShouldSkipWaitingTaskUntilNotified)
+{
+    WaitingTask task1;
+    Task* taskList[] = { &task1, NULL };
+    Scheduler s(&fakeTickFunction, taskList, &fakeIdleFunction);
+
+    s.runTask();
+    CHECK(task1.isWaiting());
+    CHECK_EQUAL(E_TICK_MAX, lastIdleTime);
+
+    task1.ready = true;
+    s.runTask();
+    CHECK_FALSE(task1.passed);
+
+    task1.notify();
+    s.runTask();
+    CHECK(task1.passed);
+    CHECK_FALSE(task1.isWaiting());
+}
+
+#ifdef CICADA_TASK_STATS
+TEST(SchedulerTest, ShouldCollectTaskStats)
+{
+    BusyTask task1(10, 3);
+    Task* taskList[] = { &task1, NULL };
+    Scheduler s(&fakeTickFunction, taskList);
+
+    fakeTick = 10;
+    s.runTask();
+    fakeTick = 25;
+    s.runTask();
+
+    TaskStats stats[2];
+    CHECK_EQUAL(1, s.dumpStats(stats, 2));
+    CHECK_EQUAL(2, stats[0].runs);
+    CHECK_EQUAL(6, stats[0].totalTime);
+    CHECK_EQUAL(3, stats[0].maxTime);
+    CHECK_EQUAL(5, stats[0].totalLateness);
+    CHECK_EQUAL(5, stats[0].maxLateness);
+    CHECK_EQUAL(12, stats[0].maxGap);
+
+    s.resetStats();
+    CHECK_EQUAL(0, task1.stats().runs);
+    CHECK_EQUAL(0, task1.stats().maxGap);
+}
+
+TEST(SchedulerTest, ShouldNotCountLatenessAfterWaiting)
+{
+    EventTask task1;
+    Task* taskList[] = { &task1, NULL };
+    Scheduler s(&fakeTickFunction, taskList);
+
+    s.runTask();
+    fakeTick = 500;
+    s.runTask();
+    task1.notify();
+    s.runTask();
+
+    CHECK_EQUAL(2, task1.runs);
+    CHECK_EQUAL(2, task1.stats().runs);
+    CHECK_EQUAL(0, task1.stats().totalLateness);
+    CHECK_EQUAL(500, task1.stats().maxGap);
+}
+#endif
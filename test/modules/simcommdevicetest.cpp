@@ -0,0 +1,789 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <string.h>
+
+#include "cicada/bufferedserial.h"
+#include "cicada/commdevices/sim7x00.h"
+#include "cicada/commdevices/sim800.h"
+#include "cicada/commdevices/udpsocket.h"
+
+using namespace Cicada;
+
+TEST_GROUP(SimCommDeviceTest)
+{
+    class BufferedSerialMock : public BufferedSerial
+    {
+      public:
+        BufferedSerialMock() {}
+
+        bool open()
+        {
+            return true;
+        }
+        void close() {}
+
+        bool isOpen()
+        {
+            return true;
+        }
+
+        bool setSerialConfig(uint32_t baudRate, uint8_t dataBits)
+        {
+            return true;
+        }
+
+        const char* portName() const
+        {
+            return NULL;
+        }
+
+        bool rawRead(uint8_t& data)
+        {
+            if (!_inBufferMock.isEmpty()) {
+                data = _inBufferMock.pull();
+                return true;
+            }
+
+            return false;
+        }
+
+        virtual bool rawWrite(uint8_t data)
+        {
+            if (!_outBufferMock.isFull()) {
+                _outBufferMock.push(data);
+                return true;
+            }
+
+            return false;
+        }
+
+        virtual void startTransmit() {}
+
+        void receive(const char* data)
+        {
+            _inBufferMock.push(data, strlen(data));
+            for (int i = 0; i < 100; i++)
+                transferToAndFromBuffer();
+        }
+
+        bool hasSent(const char* data)
+        {
+            for (int i = 0; i < 100; i++)
+                transferToAndFromBuffer();
+
+            char sent[200];
+            Size size = _outBufferMock.pull(sent, sizeof(sent) - 1);
+            sent[size] = '\0';
+            return strstr(sent, data) != NULL;
+        }
+
+        // Feeds a reply of the modem and checks what the driver sends next
+        bool exchange(Task& device, const char* reply, const char* expected)
+        {
+            receive(reply);
+            for (int i = 0; i < 10; i++) {
+                device.run();
+                for (int j = 0; j < 100; j++)
+                    transferToAndFromBuffer();
+            }
+            return hasSent(expected);
+        }
+
+        // Takes everything written to the modem out of the serial
+        Size drain(char* data, Size maxSize)
+        {
+            Size size = 0;
+            Size pulled;
+            do {
+                transferToAndFromBuffer();
+                pulled = _outBufferMock.pull(data + size, maxSize - size);
+                size += pulled;
+            } while (pulled > 0);
+            return size;
+        }
+
+        CircularBuffer<char, 200> _inBufferMock;
+        CircularBuffer<char, 200> _outBufferMock;
+    };
+
+    // Goes through the connection setup of the SIM7x00 up to opening link 0
+    static void connectDevice(BufferedSerialMock& serial, Sim7x00CommDevice& device)
+    {
+        device.setApn("internet");
+        device.setHostPort("example.com", 80);
+        CHECK(device.connect());
+
+        CHECK(serial.exchange(device, "", "ATE0\r\n"));
+        CHECK(serial.exchange(device, "OK\r\n", "AT+CGSOCKCONT"));
+        CHECK(serial.exchange(device, "OK\r\n", "AT+CSOCKSETPN"));
+        CHECK(serial.exchange(device, "OK\r\n", "AT+CIPMODE"));
+        CHECK(serial.exchange(device, "OK\r\n", "AT+NETOPEN"));
+        CHECK(serial.exchange(device, "OK\r\n+NETOPEN: 0\r\n", "AT+CIPRXGET=1"));
+        CHECK(serial.exchange(device, "OK\r\n", "AT+CDNSGIP=\"example.com\""));
+        CHECK(serial.exchange(device, "+CDNSGIP: 1,\"example.com\",\"10.0.0.1\"\r\nOK\r\n",
+            "AT+CIPOPEN=0,\"TCP\",\"10.0.0.1\",80"));
+        serial.receive("OK\r\n+CIPOPEN: 0,0\r\n");
+    }
+
+    // Opens a UDP socket to example.org on link 1 of a connected device
+    static void connectUdpSocket(BufferedSerialMock& serial, Sim7x00CommDevice& device,
+        UdpSocket& socket)
+    {
+        CHECK(device.attachSocket(socket));
+        socket.setHostPort("example.org", 123);
+        CHECK(socket.connect());
+        connectDevice(serial, device);
+
+        CHECK(serial.exchange(device, "", "AT+CDNSGIP=\"example.org\""));
+        CHECK(serial.exchange(device, "+CDNSGIP: 1,\"example.org\",\"10.0.0.2\"\r\nOK\r\n",
+            "AT+CIPOPEN=1,\"UDP\",,,123\r\n"));
+        serial.exchange(device, "OK\r\n+CIPOPEN: 0,0\r\n+CIPOPEN: 1,0\r\n", "");
+        CHECK(socket.isConnected());
+    }
+
+    // SIM7x00 which reads at most 4 bytes at a time
+    class SmallReadDevice : public Sim7x00CommDevice
+    {
+      public:
+        SmallReadDevice(IBufferedSerial& serial) : Sim7x00CommDevice(serial)
+        {
+            _maxReceiveLength = 4;
+        }
+    };
+
+    // SIM7x00 whose read buffer wraps around 3 bytes into the next write
+    class WrappingReadDevice : public Sim7x00CommDevice
+    {
+      public:
+        WrappingReadDevice(IBufferedSerial& serial) : Sim7x00CommDevice(serial)
+        {
+            uint8_t fill[E_NETWORK_BUFFERSIZE - 3] = { 0 };
+            _readBuffer.push(fill, sizeof(fill));
+            _readBuffer.discard(sizeof(fill));
+        }
+    };
+
+    // SIM7x00 whose write buffer wraps around 3 bytes into the next write
+    class WrappingWriteDevice : public Sim7x00CommDevice
+    {
+      public:
+        WrappingWriteDevice(IBufferedSerial& serial) : Sim7x00CommDevice(serial)
+        {
+            uint8_t fill[E_NETWORK_BUFFERSIZE - 3] = { 0 };
+            _writeBuffer.push(fill, sizeof(fill));
+            _writeBuffer.discard(sizeof(fill));
+        }
+    };
+
+    static void countUrc(AtReply urc, const char* line, void* context)
+    {
+        (*(int*)context)++;
+    }
+};
+
+TEST(SimCommDeviceTest, ShouldReceivePayloadAsItArrives)
+{
+    BufferedSerialMock serial;
+    WrappingReadDevice device(serial);
+    char data[20];
+
+    connectDevice(serial, device);
+    CHECK(serial.exchange(device, "+CIPRXGET: 1,0\r\n", "AT+CIPRXGET=4,0\r\n"));
+    CHECK(serial.exchange(device, "+CIPRXGET: 4,0,10\r\nOK\r\n", "AT+CIPRXGET=2,0,10\r\n"));
+
+    // The first part is handed out before the rest arrives
+    serial.exchange(device, "+CIPRXGET: 2,0,10,0\r\n0123", "");
+    CHECK_EQUAL(4, device.bytesAvailable());
+
+    // The rest goes across the end of the read buffer
+    CHECK(serial.exchange(device, "456789\r\nOK\r\n", "AT+CIPRXGET=4,0\r\n"));
+    CHECK_EQUAL(10, device.read((uint8_t*)data, sizeof(data)));
+    MEMCMP_EQUAL("0123456789", data, 10);
+    CHECK_EQUAL(10, device.linkStats().bytesReceived);
+}
+
+TEST(SimCommDeviceTest, ShouldResumeSendingWhenSerialRunsFull)
+{
+    BufferedSerialMock serial;
+    WrappingWriteDevice device(serial);
+    uint8_t payload[600];
+    uint8_t fill[E_SERIAL_BUFFERSIZE];
+    char sent[E_SERIAL_BUFFERSIZE + sizeof(payload)];
+
+    for (Size i = 0; i < sizeof(payload); i++)
+        payload[i] = 'a' + i % 26;
+    memset(fill, '-', sizeof(fill));
+
+    connectDevice(serial, device);
+    serial.exchange(device, "", "");
+    CHECK_EQUAL(sizeof(payload), device.write(payload, sizeof(payload)));
+    CHECK(serial.exchange(device, "", "AT+CIPSEND=0,600\r\n"));
+
+    // Leave less room in the serial than the payload needs
+    Size filled = serial.write(fill, serial.spaceAvailable() - 100);
+    serial.receive(">");
+    for (int i = 0; i < 10; i++)
+        device.run();
+    CHECK_EQUAL(0, serial.spaceAvailable());
+
+    // The rest follows as the serial drains, the payload is taken from
+    // both ends of the write buffer
+    Size size = 0;
+    for (int i = 0; i < 10; i++) {
+        size += serial.drain(sent + size, sizeof(sent) - size);
+        device.run();
+    }
+    CHECK_EQUAL(filled + sizeof(payload), size);
+    MEMCMP_EQUAL(payload, sent + filled, sizeof(payload));
+    CHECK_EQUAL(sizeof(payload), device.linkStats().bytesSent);
+}
+
+TEST(SimCommDeviceTest, ShouldDispatchUrcToHandlersInAnyState)
+{
+    BufferedSerialMock serial;
+    Sim7x00CommDevice device(serial);
+    int dataUrcs = 0;
+    int closeUrcs = 0;
+
+    CHECK(device.addUrcHandler(atCiprxgetData, countUrc, &dataUrcs));
+    CHECK(device.addUrcHandler(atIpclose, countUrc, &closeUrcs));
+
+    serial.receive("+CIPRXGET: 1,0\r\n+IPCLOSE: 0,1\r\n+CIPRXGET: 1,0\r\n");
+    device.run();
+
+    CHECK_EQUAL(2, dataUrcs);
+    CHECK_EQUAL(1, closeUrcs);
+}
+
+TEST(SimCommDeviceTest, ShouldNotCallRemovedHandlers)
+{
+    BufferedSerialMock serial;
+    Sim7x00CommDevice device(serial);
+    int urcs = 0;
+
+    CHECK(device.addUrcHandler(atPdpDeact, countUrc, &urcs));
+    device.removeUrcHandler(atPdpDeact, countUrc);
+
+    serial.receive("+PDP: DEACT\r\n");
+    device.run();
+
+    CHECK_EQUAL(0, urcs);
+}
+
+TEST(SimCommDeviceTest, ShouldOnlyAcceptUrcsAsLongAsSlotsAreFree)
+{
+    BufferedSerialMock serial;
+    Sim7x00CommDevice device(serial);
+
+    CHECK_FALSE(device.addUrcHandler(atOk, countUrc));
+
+    for (int i = 0; i < E_URC_HANDLERS; i++)
+        CHECK(device.addUrcHandler(atRdy, countUrc));
+    CHECK_FALSE(device.addUrcHandler(atRdy, countUrc));
+}
+
+TEST(SimCommDeviceTest, ShouldResetModemOnUnexpectedRestart)
+{
+    BufferedSerialMock serial;
+    Sim7x00CommDevice device(serial);
+
+    device.setApn("internet");
+    device.setHostPort("example.com", 80);
+    CHECK(device.connect());
+
+    device.run();
+    device.run();
+    CHECK(serial.hasSent("ATE0\r\n"));
+
+    // The modem reboots instead of answering
+    serial.receive("RDY\r\n");
+    device.run();
+    device.run();
+    CHECK(serial.hasSent("AT+CRESET\r\n"));
+
+    // RDY is expected after the reset, so connecting goes on
+    serial.receive("RDY\r\n");
+    device.run();
+    device.run();
+    CHECK(serial.hasSent("ATE0\r\n"));
+}
+
+TEST(SimCommDeviceTest, ShouldServeAdditionalSocketsOnTheirOwnLink)
+{
+    BufferedSerialMock serial;
+    Sim7x00CommDevice device(serial);
+    IPSocket socket;
+    char data[10];
+
+    CHECK(device.attachSocket(socket));
+    socket.setHostPort("example.org", 123);
+    CHECK(socket.connect());
+    connectDevice(serial, device);
+
+    // The additional socket is opened on link 1 once the device is connected
+    CHECK(serial.exchange(device, "", "AT+CDNSGIP=\"example.org\""));
+    CHECK(device.isConnected());
+    CHECK_FALSE(socket.isConnected());
+    CHECK(serial.exchange(device, "+CDNSGIP: 1,\"example.org\",\"10.0.0.2\"\r\nOK\r\n",
+        "AT+CIPOPEN=1,\"TCP\",\"10.0.0.2\",123"));
+    serial.exchange(device, "OK\r\n+CIPOPEN: 1,0\r\n", "");
+    CHECK(socket.isConnected());
+
+    // Data for link 1 ends up in the socket
+    CHECK(serial.exchange(device, "+CIPRXGET: 1,1\r\n", "AT+CIPRXGET=4,1\r\n"));
+    CHECK(serial.exchange(device, "+CIPRXGET: 4,1,5\r\nOK\r\n", "AT+CIPRXGET=2,1,5\r\n"));
+    CHECK(serial.exchange(device, "+CIPRXGET: 2,1,5,0\r\nhello\r\nOK\r\n",
+        "AT+CIPRXGET=4,1\r\n"));
+    serial.exchange(device, "+CIPRXGET: 4,1,0\r\nOK\r\n", "");
+
+    CHECK_EQUAL(0, device.bytesAvailable());
+    CHECK_EQUAL(5, socket.read((uint8_t*)data, sizeof(data)));
+    STRNCMP_EQUAL("hello", data, 5);
+
+    // Closing the socket leaves the device connected
+    socket.disconnect();
+    CHECK(serial.exchange(device, "", "AT+CIPCLOSE=1\r\n"));
+    serial.exchange(device, "OK\r\n+CIPCLOSE: 1,0\r\n", "");
+    CHECK(socket.isIdle());
+    CHECK(device.isConnected());
+}
+
+TEST(SimCommDeviceTest, ShouldKeepDatagramBoundaries)
+{
+    BufferedSerialMock serial;
+    Sim7x00CommDevice device(serial);
+    UdpSocket socket;
+    uint8_t data[10];
+
+    CHECK(device.attachSocket(socket));
+    socket.setHostPort("example.org", 123);
+    CHECK(socket.connect());
+    connectDevice(serial, device);
+
+    CHECK(serial.exchange(device, "", "AT+CDNSGIP=\"example.org\""));
+    CHECK(serial.exchange(device, "+CDNSGIP: 1,\"example.org\",\"10.0.0.2\"\r\nOK\r\n",
+        "AT+CIPOPEN=1,\"UDP\",,,123\r\n"));
+    serial.exchange(device, "OK\r\n+CIPOPEN: 1,0\r\n", "");
+    CHECK(socket.isConnected());
+
+    // Each datagram goes out with its own CIPSEND and the peer address
+    CHECK_EQUAL(3, socket.sendTo((const uint8_t*)"abc", 3));
+    CHECK_EQUAL(2, socket.sendTo((const uint8_t*)"de", 2));
+    CHECK_EQUAL(0, socket.sendTo(data, E_NETWORK_BUFFERSIZE));
+    CHECK(serial.exchange(device, "", "AT+CIPSEND=1,3,\"10.0.0.2\",123\r\n"));
+    CHECK(serial.exchange(device, ">", "abc"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CIPSEND=1,2,\"10.0.0.2\",123\r\n"));
+    CHECK(serial.exchange(device, ">", "de"));
+
+    // Each CIPRXGET read is one datagram
+    CHECK(serial.exchange(device, "OK\r\n+CIPRXGET: 1,1\r\n", "AT+CIPRXGET=4,1\r\n"));
+    CHECK(serial.exchange(device, "+CIPRXGET: 4,1,7\r\nOK\r\n", "AT+CIPRXGET=2,1,7\r\n"));
+    CHECK(serial.exchange(device, "+CIPRXGET: 2,1,4,3\r\nping\r\nOK\r\n",
+        "AT+CIPRXGET=2,1,3\r\n"));
+    serial.exchange(device, "+CIPRXGET: 2,1,3,0\r\nxyz\r\nOK\r\n", "");
+
+    CHECK_EQUAL(4, socket.bytesAvailable());
+    CHECK_EQUAL(4, socket.recvFrom(data, sizeof(data)));
+    MEMCMP_EQUAL("ping", data, 4);
+    CHECK_EQUAL(3, socket.bytesAvailable());
+    CHECK_EQUAL(2, socket.recvFrom(data, 2));
+    MEMCMP_EQUAL("xy", data, 2);
+    CHECK_EQUAL(0, socket.bytesAvailable());
+    CHECK_EQUAL(0, socket.recvFrom(data, sizeof(data)));
+}
+
+TEST(SimCommDeviceTest, ShouldMergeDatagramsReadTogether)
+{
+    BufferedSerialMock serial;
+    Sim7x00CommDevice device(serial);
+    UdpSocket socket;
+    uint8_t data[10];
+
+    connectUdpSocket(serial, device, socket);
+
+    // The modem holds "ab" and "cde", but hands them out in one read
+    CHECK(serial.exchange(device, "+CIPRXGET: 1,1\r\n", "AT+CIPRXGET=4,1\r\n"));
+    CHECK(serial.exchange(device, "+CIPRXGET: 4,1,5\r\nOK\r\n", "AT+CIPRXGET=2,1,5\r\n"));
+    serial.exchange(device, "+CIPRXGET: 2,1,5,0\r\nabcde\r\nOK\r\n", "");
+
+    CHECK_EQUAL(5, socket.recvFrom(data, sizeof(data)));
+    MEMCMP_EQUAL("abcde", data, 5);
+    CHECK_EQUAL(0, socket.bytesAvailable());
+}
+
+TEST(SimCommDeviceTest, ShouldSplitDatagramsLargerThanARead)
+{
+    BufferedSerialMock serial;
+    SmallReadDevice device(serial);
+    UdpSocket socket;
+    uint8_t data[10];
+
+    connectUdpSocket(serial, device, socket);
+
+    CHECK(serial.exchange(device, "+CIPRXGET: 1,1\r\n", "AT+CIPRXGET=4,1\r\n"));
+    CHECK(serial.exchange(device, "+CIPRXGET: 4,1,7\r\nOK\r\n", "AT+CIPRXGET=2,1,4\r\n"));
+    CHECK(serial.exchange(device, "+CIPRXGET: 2,1,4,3\r\nabcd\r\nOK\r\n",
+        "AT+CIPRXGET=2,1,3\r\n"));
+    serial.exchange(device, "+CIPRXGET: 2,1,3,0\r\nefg\r\nOK\r\n", "");
+
+    CHECK_EQUAL(4, socket.recvFrom(data, sizeof(data)));
+    MEMCMP_EQUAL("abcd", data, 4);
+    CHECK_EQUAL(3, socket.recvFrom(data, sizeof(data)));
+    MEMCMP_EQUAL("efg", data, 3);
+    CHECK_EQUAL(0, socket.bytesAvailable());
+}
+
+TEST(SimCommDeviceTest, ShouldHoldBackDatagramsUntilFullyReceived)
+{
+    BufferedSerialMock serial;
+    Sim7x00CommDevice device(serial);
+    UdpSocket socket;
+    uint8_t data[10];
+
+    connectUdpSocket(serial, device, socket);
+
+    CHECK(serial.exchange(device, "+CIPRXGET: 1,1\r\n", "AT+CIPRXGET=4,1\r\n"));
+    CHECK(serial.exchange(device, "+CIPRXGET: 4,1,6\r\nOK\r\n", "AT+CIPRXGET=2,1,6\r\n"));
+
+    // Only half of the payload has arrived yet
+    serial.exchange(device, "+CIPRXGET: 2,1,6,0\r\nabc", "");
+    CHECK_EQUAL(0, socket.bytesAvailable());
+    CHECK_EQUAL(0, socket.recvFrom(data, sizeof(data)));
+
+    CHECK(serial.exchange(device, "def\r\nOK\r\n", "AT+CIPRXGET=4,1\r\n"));
+    CHECK_EQUAL(6, socket.recvFrom(data, sizeof(data)));
+    MEMCMP_EQUAL("abcdef", data, 6);
+
+    // The framing of the next datagram is intact
+    CHECK(serial.exchange(device, "+CIPRXGET: 4,1,2\r\nOK\r\n", "AT+CIPRXGET=2,1,2\r\n"));
+    serial.exchange(device, "+CIPRXGET: 2,1,2,0\r\nxy\r\nOK\r\n", "");
+    CHECK_EQUAL(2, socket.recvFrom(data, sizeof(data)));
+    MEMCMP_EQUAL("xy", data, 2);
+    CHECK_EQUAL(0, socket.bytesAvailable());
+}
+
+TEST(SimCommDeviceTest, ShouldServeOtherSocketsWhileReadBufferIsFull)
+{
+    BufferedSerialMock serial;
+    Sim7x00CommDevice device(serial);
+    UdpSocket socket;
+    uint8_t data[10];
+
+    connectUdpSocket(serial, device, socket);
+
+    CHECK(serial.exchange(device, "+CIPRXGET: 1,1\r\n", "AT+CIPRXGET=4,1\r\n"));
+    CHECK(serial.exchange(device, "+CIPRXGET: 4,1,5\r\nOK\r\n", "AT+CIPRXGET=2,1,5\r\n"));
+    CHECK(serial.exchange(device, "+CIPRXGET: 2,1,5,0\r\nhello\r\nOK\r\n",
+        "AT+CIPRXGET=4,1\r\n"));
+
+    // The next datagram doesn't fit next to the unread one, link 0 goes first
+    CHECK(serial.exchange(device, "+CIPRXGET: 4,1,1199\r\nOK\r\n+CIPRXGET: 1,0\r\n",
+        "AT+CIPRXGET=4,0\r\n"));
+    CHECK(serial.exchange(device, "+CIPRXGET: 4,0,0\r\nOK\r\n", ""));
+    CHECK_FALSE(serial.exchange(device, "", "AT+CIPRXGET"));
+
+    // Reading the datagram makes room for the next one
+    CHECK_EQUAL(5, socket.recvFrom(data, sizeof(data)));
+    CHECK(serial.exchange(device, "", "AT+CIPRXGET=4,1\r\n"));
+}
+
+TEST(SimCommDeviceTest, ShouldKeepDatagramsIntactAcrossModemResets)
+{
+    BufferedSerialMock serial;
+    Sim7x00CommDevice device(serial);
+    UdpSocket socket;
+
+    connectUdpSocket(serial, device, socket);
+
+    // The modem restarts before the prompt for the first datagram
+    CHECK_EQUAL(3, socket.sendTo((const uint8_t*)"abc", 3));
+    CHECK_EQUAL(2, socket.sendTo((const uint8_t*)"de", 2));
+    CHECK(serial.exchange(device, "", "AT+CIPSEND=1,3,\"10.0.0.2\",123\r\n"));
+    CHECK(serial.exchange(device, "RDY\r\n", "AT+CRESET\r\n"));
+
+    // Once connected again, both datagrams go out unchanged
+    CHECK(serial.exchange(device, "RDY\r\n", "ATE0\r\n"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CGSOCKCONT"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CSOCKSETPN"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CIPMODE"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+NETOPEN"));
+    CHECK(serial.exchange(device, "OK\r\n+NETOPEN: 0\r\n", "AT+CIPRXGET=1"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CIPOPEN=0,\"TCP\",\"10.0.0.1\",80"));
+    CHECK(serial.exchange(device, "OK\r\n+CIPOPEN: 0,0\r\n", "AT+CIPOPEN=1,\"UDP\",,,123\r\n"));
+    CHECK(serial.exchange(device, "OK\r\n+CIPOPEN: 1,0\r\n",
+        "AT+CIPSEND=1,3,\"10.0.0.2\",123\r\n"));
+    CHECK(serial.exchange(device, ">", "abc"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CIPSEND=1,2,\"10.0.0.2\",123\r\n"));
+    CHECK(serial.exchange(device, ">", "de"));
+    serial.exchange(device, "OK\r\n", "");
+    CHECK_EQUAL(0, socket.bytesAvailable());
+}
+
+TEST(SimCommDeviceTest, ShouldWaitForEventsWhileIdle)
+{
+    BufferedSerialMock serial;
+    Sim7x00CommDevice device(serial);
+    UdpSocket socket;
+
+    connectUdpSocket(serial, device, socket);
+    device.run();
+    CHECK(device.isWaiting());
+
+    // Data from the modem wakes the device up
+    serial.receive("+CIPRXGET: 1,1\r\n");
+    CHECK_FALSE(device.isWaiting());
+    CHECK(serial.exchange(device, "", "AT+CIPRXGET=4,1\r\n"));
+    serial.exchange(device, "+CIPRXGET: 4,1,0\r\nOK\r\n", "");
+    CHECK(device.isWaiting());
+
+    // So do requests of the application
+    device.requestRSSI();
+    CHECK_FALSE(device.isWaiting());
+    CHECK(serial.exchange(device, "", "AT+CSQ\r\n"));
+    serial.exchange(device, "+CSQ: 20,0\r\nOK\r\n", "");
+    CHECK_EQUAL(20, device.getRSSI());
+    CHECK(device.isWaiting());
+
+    CHECK_EQUAL(3, socket.sendTo((const uint8_t*)"abc", 3));
+    CHECK_FALSE(device.isWaiting());
+    CHECK(serial.exchange(device, "", "AT+CIPSEND=1,3,\"10.0.0.2\",123\r\n"));
+}
+
+TEST(SimCommDeviceTest, ShouldPassDataThroughInTransparentMode)
+{
+    BufferedSerialMock serial;
+    Sim800CommDevice device(serial);
+    char data[10];
+
+    device.setTransparentMode(true);
+    device.setApn("internet");
+    device.setHostPort("example.com", 80);
+    CHECK(device.connect());
+
+    CHECK(serial.exchange(device, "", "ATE0\r\n"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CIPRXGET=0\r\n"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CIPMUX=0\r\n"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CIPMODE=1\r\n"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CSTT"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CIICR"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CIFSR"));
+    CHECK(serial.exchange(device, "10.1.2.3\r\n", "AT+CDNSGIP=\"example.com\""));
+    CHECK(serial.exchange(device, "OK\r\n+CDNSGIP: 1,\"example.com\",\"10.0.0.1\"\r\n",
+        "AT+CIPSTART=\"TCP\",\"10.0.0.1\",80\r\n"));
+    serial.exchange(device, "OK\r\nCONNECT\r\n", "");
+    CHECK(device.isConnected());
+
+    // Payload goes through unchanged in both directions
+    CHECK_EQUAL(4, device.write((const uint8_t*)"ping", 4));
+    CHECK(serial.exchange(device, "", "ping"));
+    serial.exchange(device, "OK\r\n", "");
+    CHECK_EQUAL(4, device.read((uint8_t*)data, sizeof(data)));
+    STRNCMP_EQUAL("OK\r\n", data, 4);
+
+    // Querying the RSSI escapes to command mode and back
+    device.requestRSSI();
+    CHECK(serial.exchange(device, "", "+++"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CSQ\r\n"));
+    CHECK(serial.exchange(device, "+CSQ: 20,0\r\nOK\r\n", "ATO\r\n"));
+    serial.exchange(device, "CONNECT\r\n", "");
+    CHECK_EQUAL(20, device.getRSSI());
+    serial.exchange(device, "more", "");
+    CHECK_EQUAL(4, device.read((uint8_t*)data, sizeof(data)));
+    STRNCMP_EQUAL("more", data, 4);
+
+    // The notice of a closed connection is not taken as payload
+    serial.exchange(device, "end\r\nCLOSED\r\n", "");
+    CHECK_EQUAL(3, device.read((uint8_t*)data, sizeof(data)));
+    STRNCMP_EQUAL("end", data, 3);
+    CHECK_FALSE(device.isConnected());
+}
+
+TEST(SimCommDeviceTest, ShouldEscapeDataModeToDisconnect)
+{
+    BufferedSerialMock serial;
+    Sim7x00CommDevice device(serial);
+
+    device.setTransparentMode(true);
+    device.setApn("internet");
+    device.setHostPort("example.com", 80);
+    CHECK(device.connect());
+
+    CHECK(serial.exchange(device, "", "ATE0\r\n"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CGSOCKCONT"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CSOCKSETPN"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CIPMODE=1\r\n"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+NETOPEN"));
+    CHECK(serial.exchange(device, "OK\r\n+NETOPEN: 0\r\n", "AT+CIPRXGET=0\r\n"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CDNSGIP=\"example.com\""));
+    CHECK(serial.exchange(device, "+CDNSGIP: 1,\"example.com\",\"10.0.0.1\"\r\nOK\r\n",
+        "AT+CIPOPEN=0,\"TCP\",\"10.0.0.1\",80\r\n"));
+    serial.exchange(device, "CONNECT 115200\r\n", "");
+    CHECK(device.isConnected());
+
+    device.disconnect();
+    CHECK(serial.exchange(device, "", "+++"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+NETCLOSE\r\n"));
+    serial.exchange(device, "OK\r\n+NETCLOSE: 0\r\n", "");
+    CHECK(device.isIdle());
+}
+
+TEST(SimCommDeviceTest, ShouldReuseCachedAddressWhenReconnecting)
+{
+    BufferedSerialMock serial;
+    Sim7x00CommDevice device(serial);
+
+    connectDevice(serial, device);
+    serial.exchange(device, "", "");
+    CHECK(device.isConnected());
+
+    device.disconnect();
+    CHECK(serial.exchange(device, "", "AT+NETCLOSE"));
+    serial.exchange(device, "+NETCLOSE: 0\r\n", "");
+    CHECK(device.isIdle());
+
+    // The address of example.com is still known
+    CHECK(device.connect());
+    CHECK(serial.exchange(device, "", "ATE0\r\n"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CGSOCKCONT"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CSOCKSETPN"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CIPMODE"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+NETOPEN"));
+    CHECK(serial.exchange(device, "OK\r\n+NETOPEN: 0\r\n", "AT+CIPRXGET=1"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CIPOPEN=0,\"TCP\",\"10.0.0.1\",80"));
+
+    // Once expired, it is looked up again
+    serial.exchange(device, "OK\r\n+CIPOPEN: 0,0\r\n", "");
+    device.setLastRun(E_DNS_CACHE_TTL);
+    device.disconnect();
+    CHECK(serial.exchange(device, "", "AT+NETCLOSE"));
+    serial.exchange(device, "+NETCLOSE: 0\r\n", "");
+    CHECK(device.connect());
+    CHECK(serial.exchange(device, "", "ATE0\r\n"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CGSOCKCONT"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CSOCKSETPN"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CIPMODE"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+NETOPEN"));
+    CHECK(serial.exchange(device, "OK\r\n+NETOPEN: 0\r\n", "AT+CIPRXGET=1"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CDNSGIP=\"example.com\""));
+}
+
+TEST(SimCommDeviceTest, ShouldNotLookUpDottedQuadAddresses)
+{
+    BufferedSerialMock serial;
+    Sim7x00CommDevice device(serial);
+
+    device.setApn("internet");
+    device.setHostPort("192.168.1.20", 1883);
+    CHECK(device.connect());
+
+    CHECK(serial.exchange(device, "", "ATE0\r\n"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CGSOCKCONT"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CSOCKSETPN"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CIPMODE"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+NETOPEN"));
+    CHECK(serial.exchange(device, "OK\r\n+NETOPEN: 0\r\n", "AT+CIPRXGET=1"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CIPOPEN=0,\"TCP\",\"192.168.1.20\",1883"));
+}
+
+TEST(SimCommDeviceTest, ShouldCollectLinkStats)
+{
+    BufferedSerialMock serial;
+    Sim7x00CommDevice device(serial);
+    device.setApn("internet");
+    device.setHostPort("example.com", 80);
+    CHECK(device.connect());
+
+    // Replies arrive at the given ticks
+    device.setLastRun(0);
+    CHECK(serial.exchange(device, "", "ATE0\r\n"));
+    device.setLastRun(5);
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CGSOCKCONT"));
+    device.setLastRun(10);
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CSOCKSETPN"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CIPMODE"));
+    CHECK(serial.exchange(device, "OK\r\n", "AT+NETOPEN"));
+    device.setLastRun(100);
+    CHECK(serial.exchange(device, "OK\r\n+NETOPEN: 0\r\n", "AT+CIPRXGET=1"));
+    device.setLastRun(110);
+    CHECK(serial.exchange(device, "OK\r\n", "AT+CDNSGIP"));
+    device.setLastRun(150);
+    CHECK(serial.exchange(device, "+CDNSGIP: 1,\"example.com\",\"10.0.0.1\"\r\nOK\r\n",
+        "AT+CIPOPEN"));
+    device.setLastRun(400);
+    serial.exchange(device, "OK\r\n+CIPOPEN: 0,0\r\n", "");
+    CHECK(device.isConnected());
+
+    // Send a few bytes
+    device.write((const uint8_t*)"ping", 4);
+    CHECK(serial.exchange(device, "", "AT+CIPSEND=0,4"));
+    CHECK(serial.exchange(device, ">", "ping"));
+
+    LinkStats stats = device.linkStats();
+    CHECK_EQUAL(100, stats.connectPhaseTime[LinkStats::phaseNetwork]);
+    CHECK_EQUAL(40, stats.connectPhaseTime[LinkStats::phaseDns]);
+    CHECK_EQUAL(250, stats.connectPhaseTime[LinkStats::phaseOpen]);
+    CHECK_EQUAL(4, stats.bytesSent);
+    CHECK_EQUAL(1, stats.sendRoundTrips);
+
+    // 0 (CSOCKSETPN, CIPMODE, CIPSEND), 5 (ATE0, CGSOCKCONT), 10 (CIPRXGET),
+    // 40 (CDNSGIP), 90 (NETOPEN) and 250 (CIPOPEN) ticks
+    CHECK_EQUAL(3, stats.commandRtt[0]);
+    CHECK_EQUAL(2, stats.commandRtt[3]);
+    CHECK_EQUAL(1, stats.commandRtt[4]);
+    CHECK_EQUAL(1, stats.commandRtt[6]);
+    CHECK_EQUAL(1, stats.commandRtt[7]);
+    CHECK_EQUAL(1, stats.commandRtt[8]);
+
+    // An unexpected restart of the modem is counted as reset
+    serial.exchange(device, "RDY\r\n", "");
+    CHECK_EQUAL(1, device.linkStats().resets[LinkStats::resetModemRestart]);
+
+    device.resetLinkStats();
+    CHECK_EQUAL(0, device.linkStats().bytesSent);
+}
+
+#ifdef CICADA_TRACE
+TEST(SimCommDeviceTest, ShouldTraceCommandsRepliesAndStates)
+{
+    BufferedSerialMock serial;
+    Sim7x00CommDevice device(serial);
+    connectDevice(serial, device);
+
+    uint8_t dump[ModemTrace::headerSize + 128 * ModemTrace::eventSize];
+    Size size = device.trace().dump(dump, sizeof(dump));
+    CHECK_EQUAL('C', dump[0]);
+    CHECK_EQUAL('T', dump[1]);
+    CHECK_EQUAL(ModemTrace::version, dump[2]);
+    CHECK_EQUAL(traceSim7x00, dump[3]);
+    Size count = dump[4] | dump[5] << 8;
+    CHECK_EQUAL(device.trace().size(), count);
+    CHECK_EQUAL(ModemTrace::headerSize + count * ModemTrace::eventSize, size);
+
+    // Count the events of interest
+    int ate0 = 0, cipopen = 0, netopen = 0, states = 0;
+    for (Size i = 0; i < count; i++) {
+        const uint8_t* event = dump + ModemTrace::headerSize + i * ModemTrace::eventSize;
+        uint16_t arg1 = event[6] | event[7] << 8;
+        if (event[4] == traceEventCommand && arg1 == ModemTrace::commandId("ATE0"))
+            ate0++;
+        if (event[4] == traceEventCommand && arg1 == ModemTrace::commandId("AT+CIPOPEN="))
+            cipopen++;
+        if (event[4] == traceEventReply && event[5] == atNetopen)
+            netopen++;
+        if (event[4] == traceEventState)
+            states++;
+    }
+    CHECK_EQUAL(1, ate0);
+    CHECK_EQUAL(1, cipopen);
+    CHECK_EQUAL(1, netopen);
+    CHECK(states > 5);
+
+    // Only the newest events are written if the buffer is too small
+    uint8_t last[ModemTrace::headerSize + 2 * ModemTrace::eventSize];
+    CHECK_EQUAL(sizeof(last), device.trace().dump(last, sizeof(last)));
+    CHECK_EQUAL(2, last[4]);
+    MEMCMP_EQUAL(dump + size - 2 * ModemTrace::eventSize, last + ModemTrace::headerSize,
+        2 * ModemTrace::eventSize);
+}
+#endif
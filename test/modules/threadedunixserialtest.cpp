@@ -0,0 +1,109 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cicada/platform/linux/threadedunixserial.h"
+
+using namespace Cicada;
+
+TEST_GROUP(ThreadedUnixSerialTest)
+{
+    int master;
+    int slave;
+    char slaveName[64];
+
+    void setup()
+    {
+        openpty(&master, &slave, slaveName, NULL, NULL);
+    }
+
+    void teardown()
+    {
+        close(slave);
+        close(master);
+    }
+
+    Size readFromMaster(char* data, Size size)
+    {
+        Size readCount = 0;
+        struct pollfd fds = { master, POLLIN, 0 };
+
+        while (readCount < size && poll(&fds, 1, 1000) > 0) {
+            ssize_t result = read(master, data + readCount, size - readCount);
+            if (result <= 0)
+                break;
+            readCount += result;
+        }
+
+        return readCount;
+    }
+};
+
+TEST(ThreadedUnixSerialTest, ShouldWakeUpWhenALineArrives)
+{
+    ThreadedUnixSerial serial(slaveName);
+    CHECK(serial.open());
+
+    bool lineBeforeWrite = serial.waitForLine(10);
+
+    const char reply[] = "+CSQ: 21,0\r\nOK\r\n";
+    CHECK_EQUAL(sizeof(reply) - 1, write(master, reply, sizeof(reply) - 1));
+
+    CHECK_FALSE(lineBeforeWrite);
+    CHECK(serial.waitForLine(1000));
+
+    char line[20];
+    serial.readLine((uint8_t*)line, sizeof(line));
+    STRCMP_EQUAL("+CSQ: 21,0\r\n", line);
+
+    serial.close();
+}
+
+TEST(ThreadedUnixSerialTest, ShouldWaitForRequestedNumberOfBytes)
+{
+    ThreadedUnixSerial serial(slaveName);
+    CHECK(serial.open());
+
+    char data[100];
+    for (Size i = 0; i < sizeof(data); i++)
+        data[i] = i;
+    CHECK_EQUAL(50, write(master, data, 50));
+
+    bool halfAvailable = serial.waitForBytes(50, 1000);
+    bool allAvailableEarly = serial.waitForBytes(100, 10);
+    CHECK_EQUAL(50, write(master, data + 50, 50));
+    bool allAvailable = serial.waitForBytes(100, 1000);
+
+    char dataOut[100];
+    Size readLen = serial.read((uint8_t*)dataOut, sizeof(dataOut));
+
+    CHECK(halfAvailable);
+    CHECK_FALSE(allAvailableEarly);
+    CHECK(allAvailable);
+    CHECK_EQUAL(100, readLen);
+    MEMCMP_EQUAL(data, dataOut, 100);
+
+    serial.close();
+}
+
+TEST(ThreadedUnixSerialTest, ShouldTransmitWrittenDataWithoutPolling)
+{
+    ThreadedUnixSerial serial(slaveName);
+    CHECK(serial.open());
+
+    const char command[] = "AT+CIPSEND=0,5\r\n";
+    serial.write((const uint8_t*)command);
+
+    char dataOut[sizeof(command)] = {};
+    Size readLen = readFromMaster(dataOut, sizeof(command) - 1);
+
+    CHECK_EQUAL(sizeof(command) - 1, readLen);
+    STRCMP_EQUAL(command, dataOut);
+
+    serial.close();
+}
@@ -0,0 +1,129 @@
+#include "CppUTest/TestHarness.h"
+
+#include "cicada/timerwheel.h"
+
+using namespace Cicada;
+
+static E_TICK_TYPE fakeTick;
+
+static E_TICK_TYPE fakeTickFunction()
+{
+    return fakeTick;
+}
+
+TEST_GROUP(TimerWheelTest)
+{
+    class DummyTask : public Task
+    {
+      public:
+        virtual void run() {}
+    };
+
+    void setup()
+    {
+        fakeTick = 0;
+    }
+
+    // Advance tick by tick, returns the tick at which the timer expired
+    E_TICK_TYPE runUntilExpired(TimerWheel & wheel, Timer & timer, E_TICK_TYPE maxTicks)
+    {
+        for (E_TICK_TYPE i = 0; i < maxTicks && !timer.hasExpired(); i++) {
+            fakeTick++;
+            wheel.advance(fakeTick);
+        }
+        return fakeTick;
+    }
+};
+
+TEST(TimerWheelTest, ShouldExpireShortTimer)
+{
+    TimerWheel wheel(&fakeTickFunction);
+    Timer timer;
+
+    wheel.start(timer, 10);
+    CHECK(timer.isRunning());
+    CHECK_EQUAL(1, wheel.numTimers());
+
+    CHECK_EQUAL(10, runUntilExpired(wheel, timer, 1000));
+    CHECK(timer.hasExpired());
+    CHECK_EQUAL(0, wheel.numTimers());
+}
+
+TEST(TimerWheelTest, ShouldExpireTimersAcrossLevels)
+{
+    TimerWheel wheel(&fakeTickFunction);
+    Timer timers[5];
+    E_TICK_TYPE timeouts[] = { 63, 64, 4097, 300000, 20000000 };
+
+    for (int i = 0; i < 5; i++)
+        wheel.start(timers[i], timeouts[i]);
+
+    for (int i = 0; i < 5; i++) {
+        CHECK_EQUAL(timeouts[i], runUntilExpired(wheel, timers[i], timeouts[i] + 1));
+    }
+}
+
+TEST(TimerWheelTest, ShouldSkipEmptySlotsWhenAdvancingInSteps)
+{
+    TimerWheel wheel(&fakeTickFunction);
+    Timer timer;
+
+    wheel.start(timer, 100000);
+    fakeTick = 99999;
+    wheel.advance(fakeTick);
+    CHECK(timer.isRunning());
+
+    fakeTick = 100000;
+    wheel.advance(fakeTick);
+    CHECK(timer.hasExpired());
+}
+
+TEST(TimerWheelTest, ShouldHandleTickWrapAround)
+{
+    fakeTick = E_TICK_MAX - 100;
+    TimerWheel wheel(&fakeTickFunction);
+    Timer timer;
+
+    wheel.start(timer, 1000);
+    CHECK_EQUAL((E_TICK_TYPE)899, runUntilExpired(wheel, timer, 2000));
+}
+
+TEST(TimerWheelTest, ShouldStopTimer)
+{
+    TimerWheel wheel(&fakeTickFunction);
+    Timer timer1;
+    Timer timer2;
+
+    wheel.start(timer1, 20);
+    wheel.start(timer2, 20);
+    wheel.stop(timer1);
+    CHECK_FALSE(timer1.isRunning());
+    CHECK_EQUAL(1, wheel.numTimers());
+
+    runUntilExpired(wheel, timer2, 100);
+    CHECK(timer2.hasExpired());
+    CHECK_FALSE(timer1.hasExpired());
+}
+
+TEST(TimerWheelTest, ShouldNotifyTaskAndScheduleItself)
+{
+    TimerWheel wheel(&fakeTickFunction);
+    DummyTask task;
+    Timer timer;
+    CHECK(wheel.isWaiting());
+
+    task.waitForEvent();
+    wheel.start(timer, 70000, &task);
+    CHECK_FALSE(wheel.isWaiting());
+
+    for (int i = 0; i < 100000 && task.isWaiting(); i++) {
+        fakeTick += wheel.delay();
+        wheel.setLastRun(fakeTick);
+        wheel.run();
+        CHECK(wheel.delay() <= E_TIMER_WHEEL_MAX_DELAY);
+    }
+
+    CHECK_FALSE(task.isWaiting());
+    CHECK_EQUAL(70000, fakeTick);
+    CHECK(wheel.isWaiting());
+}
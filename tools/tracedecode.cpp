@@ -0,0 +1,151 @@
+/*
+ * E-Lib
+ * Copyright (C) 2019 EnAccess
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+/*
+ * Decodes a trace dumped with ModemTrace::dump() into readable text.
+ *
+ * Usage: tracedecode [<trace.bin>]
+ *
+ * Reads from stdin if no file is given. Each line shows the tick of the
+ * event, the ticks since the previous event and the event itself.
+ */
+
+#include "cicada/commdevices/atparser.h"
+#include "cicada/commdevices/modemtrace.h"
+#include "cicada/commdevices/sim7x00.h"
+#include "cicada/commdevices/sim800.h"
+#include <cstdio>
+
+using namespace Cicada;
+
+// Names of the states, from the lists the drivers' enums are made of
+#define E_STATE_NAME(NAME) #NAME,
+
+static const char* sim7x00SendStates[] = { E_SIM7X00_SEND_STATES(E_STATE_NAME) };
+static const char* sim7x00ReplyStates[] = { E_SIM7X00_REPLY_STATES(E_STATE_NAME) };
+static const char* sim800SendStates[] = { E_SIM800_SEND_STATES(E_STATE_NAME) };
+static const char* sim800ReplyStates[] = { E_SIM800_REPLY_STATES(E_STATE_NAME) };
+
+// Commands sent by the drivers, the IDs are calculated from these
+static const char* commands[] = { "ATE0", "ATO", "AT+CSQ", "AT+CRESET", "AT+CGSOCKCONT=1",
+    "AT+CSOCKSETPN=1", "AT+CIPMODE=0", "AT+CIPMODE=1", "AT+NETOPEN", "AT+NETCLOSE",
+    "AT+CIPRXGET=0", "AT+CIPRXGET=1", "AT+CIPRXGET=2", "AT+CIPRXGET=4", "AT+CDNSGIP",
+    "AT+CIPOPEN", "AT+CIPSTART", "AT+CIPSEND", "AT+CIPCLOSE", "AT+CIPCLOSE=0", "AT+CIPMUX=0",
+    "AT+CIPMUX=1", "AT+CSTT", "AT+CIICR", "AT+CIFSR", "AT+CIPSHUT", "+++" };
+
+#define COUNT(ARRAY) (sizeof(ARRAY) / sizeof(ARRAY[0]))
+
+static const char* name(const char* const* names, Size count, uint8_t index)
+{
+    return index < count ? names[index] : "?";
+}
+
+static const char* commandName(uint16_t id)
+{
+    for (Size i = 0; i < COUNT(commands); i++) {
+        if (ModemTrace::commandId(commands[i]) == id)
+            return commands[i];
+    }
+    return NULL;
+}
+
+int main(int argc, char* argv[])
+{
+    FILE* file = argc > 1 ? fopen(argv[1], "rb") : stdin;
+    if (!file) {
+        fprintf(stderr, "Can't open %s\n", argv[1]);
+        return 1;
+    }
+
+    uint8_t header[ModemTrace::headerSize];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) || header[0] != 'C'
+        || header[1] != 'T') {
+        fprintf(stderr, "Not a modem trace\n");
+        return 1;
+    }
+    if (header[2] != ModemTrace::version) {
+        fprintf(stderr, "Unsupported trace version %d\n", header[2]);
+        return 1;
+    }
+
+    const char* const* sendStates = sim7x00SendStates;
+    Size sendStateCount = COUNT(sim7x00SendStates);
+    const char* const* replyStates = sim7x00ReplyStates;
+    Size replyStateCount = COUNT(sim7x00ReplyStates);
+    if (header[3] == traceSim800) {
+        sendStates = sim800SendStates;
+        sendStateCount = COUNT(sim800SendStates);
+        replyStates = sim800ReplyStates;
+        replyStateCount = COUNT(sim800ReplyStates);
+    }
+
+    unsigned count = header[4] | header[5] << 8;
+    printf("%s trace, %u events\n", header[3] == traceSim800 ? "SIM800" : "SIM7x00", count);
+
+    uint32_t previous = 0;
+    uint8_t event[ModemTrace::eventSize];
+    for (unsigned i = 0; i < count; i++) {
+        if (fread(event, 1, sizeof(event), file) != sizeof(event)) {
+            fprintf(stderr, "Trace truncated after %u events\n", i);
+            return 1;
+        }
+
+        uint32_t time = event[0] | event[1] << 8 | event[2] << 16 | (uint32_t)event[3] << 24;
+        uint8_t arg0 = event[5];
+        uint16_t arg1 = event[6] | event[7] << 8;
+        printf("%10u %+7d  ", time, i > 0 ? (int32_t)(time - previous) : 0);
+        previous = time;
+
+        switch (event[4]) {
+        case traceEventState:
+            printf("state    %s / %s\n", name(sendStates, sendStateCount, arg0),
+                name(replyStates, replyStateCount, arg1));
+            break;
+
+        case traceEventCommand: {
+            const char* command = commandName(arg1);
+            if (command)
+                printf("command  %s\n", command);
+            else
+                printf("command  0x%04x\n", arg1);
+            break;
+        }
+
+        case traceEventReply: {
+            const char* reply = AtParser::replyName((AtReply)arg0);
+            printf("reply    %s\n", reply ? reply : "unknown");
+            break;
+        }
+
+        default:
+            printf("unknown  %d %d %d\n", event[4], arg0, arg1);
+            break;
+        }
+    }
+
+    if (file != stdin)
+        fclose(file);
+
+    return 0;
+}